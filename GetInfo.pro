@@ -19,15 +19,25 @@ SOURCES += \
     KDateTimeSeriesChartView.cpp \
     model/DirectoryStore.cpp \
     model/MimeDetails.cpp \
+    model/MimeSpillFile.cpp \
+    model/ExtensionTable.cpp \
     model/WorkStack.cpp \
     model/DirectoryScanSwitch.cpp \
     model/HistoryProvider.cpp \
+    model/PathTable.cpp \
     view_model/kfilesystemmodel.cpp \
     view_model/kmimesizesmodel.cpp \
+    view_model/ksnapshotdiffmodel.cpp \
     view_model/kmapper.cpp \
     view_model/kdatetimeserieschartmodel.cpp \
     dir_scanner/DirectoriesScanOrchestrator.cpp \
-    dir_scanner/DirectoryScanner.cpp
+    dir_scanner/DirectoryScanner.cpp \
+    dir_scanner/ParallelScanEngine.cpp \
+    dir_scanner/DirectoryWatcher.cpp \
+    dir_scanner/DirectoryReaderFactory.cpp \
+    dir_scanner/StdDirectoryReader.cpp \
+    dir_scanner/LinuxDirectoryReader.cpp \
+    dir_scanner/IoUringStatx.cpp
 
 HEADERS += \
     getinfo.h \
@@ -37,21 +47,36 @@ HEADERS += \
     FileSizeDivisor.h \
     KDateTimeSeriesChartView.h \
     model/DirectoryDetails.h \
+    model/DirectoryListing.h \
+    model/PackedDirectory.h \
     model/DirectoryProcessingStatus.h \
     model/DirectoryStore.h \
     model/MimeDetails.h \
+    model/MimeSpillFile.h \
+    model/ExtensionTable.h \
     model/WorkStack.h \
     model/DirectoryScanSwitch.h \
     model/HistoryProvider.h \
+    model/PathTable.h \
     view_model/kfilesystemmodel.h \
     view_model/kmimesizesmodel.h \
+    view_model/ksnapshotdiffmodel.h \
     view_model/kmapper.h \
     view_model/kdatetimeserieschartmodel.h \
     dir_scanner/DirectoriesScanOrchestrator.h \
     dir_scanner/DirectoryScanner.h \
     dir_scanner/IDirectoryScannerEventSink.h \
+    dir_scanner/IDirectoryReader.h \
+    dir_scanner/DirectoryReaderFactory.h \
+    dir_scanner/StdDirectoryReader.h \
+    dir_scanner/LinuxDirectoryReader.h \
+    dir_scanner/IoUringStatx.h \
+    dir_scanner/ParallelScanEngine.h \
+    dir_scanner/DirectoryWatcher.h \
+    dir_scanner/WorkStealingQueue.h \
     dir_scanner/KDirectoryInfo.h \
-    dir_scanner/KMimeSizesInfo.h
+    dir_scanner/KMimeSizesInfo.h \
+    dir_scanner/KScanUpdateBatch.h
 
 LIBS += \
     -L$$PWD/libs/yasw -lyasw
@@ -12,14 +12,16 @@ KDateTimeSeriesChartView::KDateTimeSeriesChartView(
       m_axisXTitle(axisXTitle),
       m_axisYTitle(axisYTitle),
       m_series(nullptr),
+      m_chart(nullptr),
       m_axisX(nullptr),
       m_axisY(nullptr)
 {
     assert(!!m_viewModel);
 
     m_series = new QLineSeries();
+    m_series->setName(tr("Total"));
 
-    QChart *m_chart = new QChart();
+    m_chart = new QChart();
     m_chart->addSeries(m_series);
     m_chart->legend()->hide();
     m_chart->setTitle(m_chartTitle);
@@ -51,6 +53,42 @@ KDateTimeSeriesChartView::getAxisYTitle() const
     return m_axisYTitle + "," + FileSizeDivisorUtils::getDivisorSuffix(divisor);
 }
 
+void
+KDateTimeSeriesChartView::updateNamedSeries()
+{
+    const int modelSeriesCount = m_viewModel->namedSeriesCount();
+
+    bool sameSeries = static_cast<int>(m_namedSeries.size()) == modelSeriesCount;
+    for (int i = 0; sameSeries && i < modelSeriesCount; ++i)
+        sameSeries = m_namedSeries[i]->name() == m_viewModel->namedSeriesName(i);
+
+    if (sameSeries)
+        return;
+
+    for (auto pSeries : m_namedSeries)
+    {
+        m_chart->removeSeries(pSeries);
+        delete pSeries;
+    }
+
+    m_namedSeries.clear();
+
+    for (int i = 0; i < modelSeriesCount; ++i)
+    {
+        auto pSeries = new QLineSeries();
+        pSeries->setName(m_viewModel->namedSeriesName(i));
+
+        m_chart->addSeries(pSeries);
+        pSeries->attachAxis(m_axisX);
+        pSeries->attachAxis(m_axisY);
+
+        m_namedSeries.push_back(pSeries);
+    }
+
+    // Nothing to tell apart with a single series
+    m_chart->legend()->setVisible(!m_namedSeries.empty());
+}
+
 void
 KDateTimeSeriesChartView::recalcRange()
 {
@@ -58,6 +96,27 @@ KDateTimeSeriesChartView::recalcRange()
     qint64 maxMSec = 0;
     qreal minY = 0;
     qreal maxY = 0;
+    bool hasPoints = false;
+
+    const auto extendRange = [&](const QPointF& p) {
+        qint64 msec = p.x();
+        qreal y = p.y();
+
+        if (!hasPoints)
+        {
+            minMSec = maxMSec = msec;
+            minY = maxY = y;
+            hasPoints = true;
+        }
+        else
+        {
+            minMSec = std::min(minMSec, msec);
+            maxMSec = std::max(maxMSec, msec);
+
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+    };
 
     const int count = m_series->count();
     const int modelCount = m_viewModel->count();
@@ -70,30 +129,33 @@ KDateTimeSeriesChartView::recalcRange()
     for (int i = 0; i < modelCount; ++i)
     {
         auto p = m_viewModel->at(i);
-        qint64 msec = p.x();
-        qreal y = p.y();
 
         if (isNewSeries)
             m_series->append(p);
         else
             m_series->replace(i, p);
 
-        if (0 == i)
+        extendRange(p);
+    }
+
+    updateNamedSeries();
+
+    for (int seriesIndex = 0; seriesIndex < static_cast<int>(m_namedSeries.size()); ++seriesIndex)
+    {
+        QVector<QPointF> points;
+
+        const int pointCount = m_viewModel->namedSeriesPointCount(seriesIndex);
+        for (int i = 0; i < pointCount; ++i)
         {
-            minMSec = maxMSec = msec;
-            minY = maxY = y;
+            auto p = m_viewModel->namedSeriesAt(seriesIndex, i);
+            points.append(p);
+            extendRange(p);
         }
-        else
-        {
-            minMSec = std::min(minMSec, msec);
-            maxMSec = std::max(maxMSec, msec);
 
-            minY = std::min(minY, y);
-            maxY = std::max(maxY, y);
-        }
+        m_namedSeries[seriesIndex]->replace(points);
     }
 
-    if (0 < modelCount)
+    if (hasPoints)
     {
         auto dtMin = QDateTime(QDateTime::fromMSecsSinceEpoch(minMSec).date());
         auto dtMax = QDateTime(QDateTime::fromMSecsSinceEpoch(maxMSec).date().addDays(1));
@@ -1,6 +1,7 @@
 #ifndef KDateTimeSeriesChartView_H
 #define KDateTimeSeriesChartView_H
 
+#include <vector>
 #include <QChartView>
 #include <QLineSeries>
 #include <QDateTimeAxis>
@@ -29,10 +30,17 @@ private:
     QString m_axisYTitle;
 
     QtCharts::QLineSeries* m_series;
+
+    // Named series of the model, owned by the chart
+    std::vector<QtCharts::QLineSeries*> m_namedSeries;
+
     QtCharts::QChart* m_chart;
     QtCharts::QDateTimeAxis* m_axisX;
     QtCharts::QValueAxis* m_axisY;
 
+    // Recreates named series if the model has got other ones
+    void updateNamedSeries();
+
     void recalcRange();
     QString getAxisYTitle() const;
 
@@ -5,7 +5,7 @@
 ProgressDlg::ProgressDlg(QWidget* parent,
     const QString& windowTitle,
     const QString& labelText,
-    TCallback worker,
+    TWorker worker,
     TCallback onComplete)
     : m_parent(parent),
       m_windowTitle(windowTitle),
@@ -42,8 +42,8 @@ ProgressDlg::start()
     m_progressDlg = std::make_unique<QProgressDialog>(m_parent);
 
     m_progressDlg->setWindowModality(Qt::WindowModal);
-    m_progressDlg->setLabelText(tr("Please wait..."));
-    m_progressDlg->setWindowTitle(tr("Save results to database"));
+    m_progressDlg->setLabelText(m_labelText);
+    m_progressDlg->setWindowTitle(m_windowTitle);
     m_progressDlg->setRange(0, 100);
 
     // Disable [Cancel] button
@@ -101,7 +101,9 @@ ProgressDlg::workerWrapper()
 
     try
     {
-        m_worker();
+        m_worker([this](int progressPercentage) {
+            setProgressPercentage(progressPercentage);
+        });
 
         m_progressPromise->set_value();
     }
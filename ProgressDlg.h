@@ -12,19 +12,23 @@ class ProgressDlg : public QObject
 public:
     typedef std::function<void(void)> TCallback;
 
+    // Worker may report its progress (percentage) via the given callback
+    typedef std::function<void(int)> TProgressCallback;
+    typedef std::function<void(const TProgressCallback&)> TWorker;
+
     ProgressDlg(QWidget* parent,
         const QString& windowTitle,
         const QString& labelText,
-        TCallback worker,
+        TWorker worker,
         TCallback onComplete);
 
 private:
     QWidget* m_parent;
-    const QString& m_windowTitle;
-    const QString& m_labelText;
+    QString m_windowTitle;
+    QString m_labelText;
 
     // Callbacks
-    TCallback m_worker;
+    TWorker m_worker;
     TCallback m_onComplete;
 
     typedef std::unique_ptr<QProgressDialog> TProgressDialogPtr;
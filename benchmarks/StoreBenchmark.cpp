@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <vector>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include "model/DirectoryStore.h"
+#include "model/PathTable.h"
+#include "settings.h"
+#include "utils.h"
+
+// Each directory of the synthetic tree has this many subdirectories
+#define BENCHMARK_FANOUT 10
+
+// Directories of the synthetic tree unless given on the command line
+#define BENCHMARK_DEFAULT_DIRECTORY_COUNT 1000000
+
+// Directories changed between two snapshots of the history benchmark (along with their parents)
+#define BENCHMARK_CHANGED_PERCENT 1
+
+// History of each probed directory is read this many times
+#define BENCHMARK_HISTORY_REPEAT_COUNT 10
+
+namespace
+{
+    // The benchmark gets its own settings and database, which are recreated on each run
+    void resetDatabase()
+    {
+        QDir().mkpath(Settings::instance()->directory());
+
+        const auto& dbFileName = QString::fromStdWString(Settings::instance()->dbFileName());
+        for (const auto& suffix : { "", "-wal", "-shm" })
+            QFile::remove(dbFileName + suffix);
+    }
+
+    // Stats of the index-th directory of the synthetic tree, which differ for each generation
+    DirectoryDetails
+    makeDirectoryDetails(size_t index, size_t directoryCount, size_t generation)
+    {
+        DirectoryDetails dirDetails;
+        dirDetails.status = DirectoryProcessingStatus::Ready;
+
+        const size_t firstChild = index * BENCHMARK_FANOUT + 1;
+        dirDetails.subdirectoryCount = firstChild < directoryCount ?
+            static_cast<unsigned long>(std::min<size_t>(BENCHMARK_FANOUT, directoryCount - firstChild)) : 0;
+        dirDetails.totalFileCount = static_cast<unsigned long>(index % 1000 + generation);
+        dirDetails.totalSize = 4096ull * (directoryCount - index + generation);
+
+        return dirDetails;
+    }
+
+    // Puts Ready directories of a synthetic tree to the store, breadth-first.
+    //  Paths are not created on disk.
+    std::vector<TPathId>
+    fillStore(size_t directoryCount)
+    {
+        auto pPathTable = PathTable::instance();
+
+        std::vector<TPathId> pathIds;
+        pathIds.reserve(directoryCount);
+        pathIds.push_back(pPathTable->intern(QDir::temp().canonicalPath() + "/getinfo-benchmark"));
+
+        for (size_t i = 0; pathIds.size() < directoryCount; ++i)
+        {
+            for (int child = 0; BENCHMARK_FANOUT > child && pathIds.size() < directoryCount; ++child)
+                pathIds.push_back(pPathTable->internChild(pathIds[i], QString("d%1").arg(child)));
+        }
+
+        auto pStore = DirectoryStore::instance();
+        for (size_t i = 0; i < pathIds.size(); ++i)
+            pStore->upsertDirectory(pathIds[i], makeDirectoryDetails(i, pathIds.size(), 0), true);
+
+        return pathIds;
+    }
+
+    // Times saving of a snapshot of all the directories (the first one, so each directory is a row)
+    void
+    benchmarkSave(size_t directoryCount)
+    {
+        fillStore(directoryCount);
+
+        const auto startTime = std::chrono::steady_clock::now();
+        DirectoryStore::instance()->saveCurrentData();
+        const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+
+        qInfo() << "save:" << directoryCount << "directories in" << elapsedMs << "ms,"
+            << (directoryCount * 1000 / std::max<long long>(elapsedMs, 1)) << "rows/s";
+    }
+
+    // Times reading history of the root, a middle and the last (leaf) directory
+    void
+    measureHistory(const std::vector<TPathId>& pathIds, size_t snapshotCount)
+    {
+        auto pStore = DirectoryStore::instance();
+        auto pPathTable = PathTable::instance();
+
+        for (const size_t index : { size_t(0), pathIds.size() / 2, pathIds.size() - 1 })
+        {
+            const auto& unifiedPath = pPathTable->path(pathIds[index]);
+
+            size_t pointCount = 0;
+            const auto startTime = std::chrono::steady_clock::now();
+            for (int i = 0; i < BENCHMARK_HISTORY_REPEAT_COUNT; ++i)
+                pointCount = pStore->getDirectoryStatsHistory(unifiedPath).size();
+            const auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startTime).count();
+
+            qInfo() << "history:" << snapshotCount << "snapshots, directory" << index << "("
+                << pointCount << "points ) in" << (elapsedUs / BENCHMARK_HISTORY_REPEAT_COUNT) << "us";
+        }
+    }
+
+    // Saves 1000 snapshots, each one changing a part of directories along with their parents,
+    //  and times history reads at 1, 100 and 1000 snapshots
+    void
+    benchmarkHistory(size_t directoryCount)
+    {
+        const auto& pathIds = fillStore(directoryCount);
+
+        auto pStore = DirectoryStore::instance();
+        pStore->saveCurrentData();
+        measureHistory(pathIds, 1);
+
+        const size_t changedCount = std::max<size_t>(1, pathIds.size() * BENCHMARK_CHANGED_PERCENT / 100);
+        const size_t stride = pathIds.size() / changedCount;
+
+        // Generation which a directory was changed in last time, parents are changed once per snapshot
+        std::vector<size_t> changedGenerations(pathIds.size(), 0);
+
+        for (size_t generation = 1; 1000 > generation; ++generation)
+        {
+            for (size_t i = generation % stride; i < pathIds.size(); i += stride)
+            {
+                for (size_t index = i; changedGenerations[index] != generation; index = (index - 1) / BENCHMARK_FANOUT)
+                {
+                    changedGenerations[index] = generation;
+                    pStore->upsertDirectory(pathIds[index], makeDirectoryDetails(index, pathIds.size(), generation), true);
+
+                    if (0 == index)
+                        break;
+                }
+            }
+
+            pStore->saveCurrentData();
+
+            if (99 == generation || 999 == generation)
+                measureHistory(pathIds, generation + 1);
+        }
+    }
+
+    void
+    printUsage()
+    {
+        qInfo() << "Usage: StoreBenchmark save|history [directory count]";
+    }
+}
+
+// A run covers one tree size, since the store is a singleton, e.g.:
+//  StoreBenchmark save 1000000
+//  StoreBenchmark save 10000000
+//  StoreBenchmark history 1000000
+int
+main(int argc, char *argv[])
+{
+    try
+    {
+        QCoreApplication::setOrganizationName("zenonby");
+        QCoreApplication::setApplicationName("directory-GetInfo-benchmark");
+
+        QCoreApplication a(argc, argv);
+
+        const auto& args = a.arguments();
+        if (2 > args.size())
+        {
+            printUsage();
+            return 1;
+        }
+
+        bool ok = true;
+        const size_t directoryCount = 2 < args.size() ?
+            args[2].toULongLong(&ok) : BENCHMARK_DEFAULT_DIRECTORY_COUNT;
+
+        if (!ok || 0 == directoryCount)
+        {
+            printUsage();
+            return 1;
+        }
+
+        resetDatabase();
+
+        if ("save" == args[1])
+        {
+            benchmarkSave(directoryCount);
+        }
+        else if ("history" == args[1])
+        {
+            benchmarkHistory(directoryCount);
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+
+        Settings::instance()->fini();
+    }
+    catch (const std::exception& ex)
+    {
+        qCritical() << "ERROR: " << ex.what();
+        return 1;
+    }
+
+    return 0;
+}
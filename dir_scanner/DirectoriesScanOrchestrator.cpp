@@ -1,8 +1,16 @@
 #include <QObject>
+#include <QDebug>
 #include <thread>
+#include <chrono>
 #include "utils.h"
 #include "DirectoryScanner.h"
 #include "DirectoriesScanOrchestrator.h"
+#include "model/DirectoryStore.h"
+#include "settings.h"
+
+#define ORCHESTRATOR_PREFIX "orchestrator"
+#define ORCHESTRATOR_WARM_START_NAME ORCHESTRATOR_PREFIX "/warm_start"
+#define ORCHESTRATOR_MEMORY_REPORT_NAME ORCHESTRATOR_PREFIX "/memory_report"
 
 DirectoriesScanOrchestrator::DirectoriesScanOrchestrator()
     : m_ignoreCallbackComplete(false)
@@ -23,6 +31,10 @@ DirectoriesScanOrchestrator::instance()
 void
 DirectoriesScanOrchestrator::fini()
 {
+    m_stopWarmStart = true;
+    if (m_threadWarmStart.joinable())
+        m_threadWarmStart.join();
+
     waitForActiveFutureToFinish();
 }
 
@@ -62,13 +74,17 @@ DirectoriesScanOrchestrator::setAndGetActiveFuture(std::future<DirectoryProcessi
     return futClone.get();
 }
 
+void
+DirectoriesScanOrchestrator::focusDirectory(const QString& dirPath)
+{
+    DirectoryScanner::instance()->setFocusedPath(dirPath);
+}
+
 void
 DirectoriesScanOrchestrator::scanDirectoriesSequentially(
     const std::vector<QString>& directories,
     std::function<void()> callbackComplete)
 {
-    DirectoryScanner::instance()->resetFocusedPathWithLocking();
-
     waitForActiveFutureToFinish();
 
     std::thread th(
@@ -84,9 +100,16 @@ DirectoriesScanOrchestrator::scanDirectoriesSequentiallyWorker(
 {
     KDBG_CURRENT_THREAD_NAME(L"DirectoriesScanOrchestrator::scanDirectoriesSequentiallyWorker");
 
+    // Rescan everything, unchanged directories are revalidated without being re-read.
+    //  Walks the whole data store, thus not on UI thread; shown directories get their new status.
+    DirectoryStore::instance()->invalidateScanResults(
+        [](const std::vector<TPathId>& pathIds) {
+            DirectoryScanner::instance()->notifyDirectoriesStored(pathIds);
+        });
+
     for (auto path : directories)
     {
-        auto fut = DirectoryScanner::instance()->setFocusedPathAndGetFuture(path);
+        auto fut = DirectoryScanner::instance()->scanInBackgroundAndGetFuture(path);
 
         try
         {
@@ -97,7 +120,7 @@ DirectoriesScanOrchestrator::scanDirectoriesSequentiallyWorker(
             // Store this future in a member shared future and wait for it's result
             auto status = setAndGetActiveFuture(std::move(fut));
 
-            // Pending status means that scanning was cancelled
+            // Pending status means that scanning was cancelled (on exit)
             if (DirectoryProcessingStatus::Pending == status)
                 break;
         }
@@ -113,6 +136,8 @@ DirectoriesScanOrchestrator::scanDirectoriesSequentiallyWorker(
         }
     }
 
+    logMemoryReport();
+
     std::scoped_lock lock_(m_sync);
     if (!m_ignoreCallbackComplete)
     {
@@ -122,6 +147,80 @@ DirectoriesScanOrchestrator::scanDirectoriesSequentiallyWorker(
     }
 }
 
+void
+DirectoriesScanOrchestrator::logMemoryReport()
+{
+    if (!lcDiagnostics().isDebugEnabled() || !readMemoryReport())
+        return;
+
+    const auto report = DirectoryStore::instance()->getMemoryReport();
+    if (0 == report.directoryCount)
+        return;
+
+    const auto perDirectory = [&report](size_t bytes) {
+        return static_cast<double>(bytes) / report.directoryCount;
+    };
+
+    qCDebug(lcDiagnostics) << "Memory per directory (" << report.directoryCount << "directories ):"
+        << "record" << perDirectory(report.directoryBytes)
+        << "(unpacked" << perDirectory(report.unpackedDirectoryBytes) << "), mime lists"
+        << perDirectory(report.mimeListBytes) << "(" << report.mimeListCount << "lists ), listings"
+        << perDirectory(report.listingBytes) << ", paths" << perDirectory(report.pathBytes)
+        << "; spilled mime lists" << report.spilledMimeListCount << "(" << report.spillFileBytes << "bytes on disk," << report.spillFileFreeBytes << "free )";
+}
+
+bool
+DirectoriesScanOrchestrator::readMemoryReport()
+{
+    return Settings::instance()->value(ORCHESTRATOR_MEMORY_REPORT_NAME, false).toBool();
+}
+
+bool
+DirectoriesScanOrchestrator::readWarmStart()
+{
+    // Show the last saved snapshot until directories are scanned again
+    return Settings::instance()->value(ORCHESTRATOR_WARM_START_NAME, true).toBool();
+}
+
+void
+DirectoriesScanOrchestrator::startWarmStart()
+{
+    assert(!m_threadWarmStart.joinable());
+
+    if (!readWarmStart())
+        return;
+
+    m_threadWarmStart = std::thread(&DirectoriesScanOrchestrator::warmStartWorker, this);
+}
+
+void
+DirectoriesScanOrchestrator::warmStartWorker()
+{
+    KDBG_CURRENT_THREAD_NAME(L"DirectoriesScanOrchestrator::warmStartWorker");
+
+    try
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        size_t loadedCount = DirectoryStore::instance()->loadLastSnapshot(
+            [](const std::vector<TPathId>& pathIds) {
+                DirectoryScanner::instance()->notifyDirectoriesStored(pathIds);
+            },
+            [this]() {
+                return m_stopWarmStart.load();
+            });
+
+        const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+
+        qCDebug(lcDiagnostics) << "Warm start:" << loadedCount << "directories loaded in" << elapsedMs << "ms";
+    }
+    catch (const std::exception& ex)
+    {
+        qCritical() << "ERROR: " << ex.what() << endl;
+    }
+}
+
 void
 DirectoriesScanOrchestrator::ignoreCallbackComplete()
 {
@@ -5,12 +5,15 @@
 #include <vector>
 #include <optional>
 #include <future>
+#include <thread>
+#include <atomic>
 #include <QString>
 #include "model/DirectoryProcessingStatus.h"
 
 // Singleton which manages lifetime of a worker thread which performs full scanning
 //	and it's iteration with UI initiated scans.
-// It must be used by client code to automatically cancel already running scans and schedule new ones.
+// It must be used by client code to schedule scans: focused directories are scanned
+//	with the highest priority, while full scanning keeps progressing in the background.
 class DirectoriesScanOrchestrator
 {
 public:
@@ -23,7 +26,11 @@ public:
 
 	void waitForActiveFutureToFinish();
 
-	// Scans specified directories sequentially, calls callbackComplete when all dirs are scanned
+	// Scans dirPath first. A previously focused directory is not cancelled, but finished in the background.
+	void focusDirectory(const QString& dirPath);
+
+	// Invalidates all scan results, then scans specified directories sequentially
+	//	with background priority, calls callbackComplete when all dirs are scanned
 	void scanDirectoriesSequentially(
 		const std::vector<QString>& directories,
 		std::function<void()> callbackComplete);
@@ -31,6 +38,11 @@ public:
 	// Cancels execution of callbackComplete specified in scanDirectoriesSequentially()
 	void ignoreCallbackComplete();
 
+	// Loads the last saved snapshot into the data store in the background (unless disabled
+	//	in settings), so that numbers are shown before directories are scanned.
+	//	Loaded directories are Stale and get re-scanned as usual.
+	void startWarmStart();
+
 private:
 	DirectoriesScanOrchestrator();
 	DirectoriesScanOrchestrator(const DirectoriesScanOrchestrator&) = delete;
@@ -54,6 +66,19 @@ private:
 
 	// Assigns active future and wait for its completion
 	DirectoryProcessingStatus setAndGetActiveFuture(std::future<DirectoryProcessingStatus>&& fut);
+
+	// Logs memory taken by the data store per directory. The report walks the whole store,
+	//	thus is made only if enabled (orchestrator/memory_report) along with diagnostics logging.
+	static void logMemoryReport();
+
+	static bool readMemoryReport();
+
+	static bool readWarmStart();
+
+	std::thread m_threadWarmStart;
+	std::atomic<bool> m_stopWarmStart = false;
+
+	void warmStartWorker();
 };
 
 #endif // DIRECTORIESSCANORCHESTRATOR_H
@@ -0,0 +1,62 @@
+#include <cassert>
+#include <QDebug>
+
+#include "DirectoryReaderFactory.h"
+#include "StdDirectoryReader.h"
+#include "LinuxDirectoryReader.h"
+
+#define DIRECTORY_READER_STD "std"
+#define DIRECTORY_READER_GETDENTS "getdents"
+#define DIRECTORY_READER_GETDENTS_IO_URING "getdents_uring"
+
+std::unique_ptr<IDirectoryReader>
+DirectoryReaderFactory::create(DirectoryReaderType type)
+{
+    switch (type)
+    {
+    case DirectoryReaderType::LinuxGetdents:
+    case DirectoryReaderType::LinuxGetdentsIoUring:
+#ifdef __linux__
+        return std::make_unique<LinuxDirectoryReader>(
+            DirectoryReaderType::LinuxGetdentsIoUring == type);
+#else
+        qWarning() << "getdents directory reader is not available, falling back to std::filesystem";
+        break;
+#endif
+    case DirectoryReaderType::StdFilesystem:
+        break;
+    default:
+        assert(!"Unexpected value");
+    }
+
+    return std::make_unique<StdDirectoryReader>();
+}
+
+DirectoryReaderType
+DirectoryReaderFactory::fromString(const QString& sType)
+{
+    if (sType == DIRECTORY_READER_GETDENTS)
+        return DirectoryReaderType::LinuxGetdents;
+    else if (sType == DIRECTORY_READER_GETDENTS_IO_URING)
+        return DirectoryReaderType::LinuxGetdentsIoUring;
+
+    return DirectoryReaderType::StdFilesystem;
+}
+
+QString
+DirectoryReaderFactory::toString(DirectoryReaderType type)
+{
+    switch (type)
+    {
+    case DirectoryReaderType::StdFilesystem:
+        return DIRECTORY_READER_STD;
+    case DirectoryReaderType::LinuxGetdents:
+        return DIRECTORY_READER_GETDENTS;
+    case DirectoryReaderType::LinuxGetdentsIoUring:
+        return DIRECTORY_READER_GETDENTS_IO_URING;
+    default:
+        assert(!"Unexpected value");
+    }
+
+    return DIRECTORY_READER_STD;
+}
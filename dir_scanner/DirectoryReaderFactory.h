@@ -0,0 +1,27 @@
+#ifndef DIRECTORYREADERFACTORY_H
+#define DIRECTORYREADERFACTORY_H
+
+#include <memory>
+#include <QString>
+
+#include "IDirectoryReader.h"
+
+// Available directory listing backends
+enum class DirectoryReaderType
+{
+	StdFilesystem = 0,	// std::filesystem::directory_iterator, portable
+	LinuxGetdents,		// getdents64 + statx relative to the directory fd, Linux only
+	LinuxGetdentsIoUring,	// Same as LinuxGetdents, but statx calls are batched via io_uring
+};
+
+struct DirectoryReaderFactory
+{
+	// Falls back to StdFilesystem if the requested backend is not available on this platform
+	static std::unique_ptr<IDirectoryReader> create(DirectoryReaderType type);
+
+	// Settings value <-> type
+	static DirectoryReaderType fromString(const QString& sType);
+	static QString toString(DirectoryReaderType type);
+};
+
+#endif // DIRECTORYREADERFACTORY_H
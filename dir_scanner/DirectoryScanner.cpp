@@ -11,12 +11,23 @@
 #include "config.h"
 
 #include "DirectoryScanner.h"
+#include "DirectoryReaderFactory.h"
 #include "KDirectoryInfo.h"
 #include "model/DirectoryScanSwitch.h"
 #include "model/DirectoryStore.h"
 #include "view_model/kmapper.h"
+#include "settings.h"
 #include "utils.h"
 
+#define SCANNER_PREFIX "scanner"
+#define SCANNER_THREAD_COUNT_NAME SCANNER_PREFIX "/thread_count"
+#define SCANNER_READER_NAME SCANNER_PREFIX "/reader"
+#define SCANNER_INCREMENTAL_RESCAN_NAME SCANNER_PREFIX "/incremental_rescan"
+#define SCANNER_LIVE_UPDATE_NAME SCANNER_PREFIX "/live_update"
+
+// Throttles UI updates while scanning
+#define NOTIFY_INTERVAL 500ms
+
 using namespace std::chrono_literals;
 
 DirectoryScanner*
@@ -27,7 +38,22 @@ DirectoryScanner::instance()
 }
 
 DirectoryScanner::DirectoryScanner()
-: m_threadWorker(&DirectoryScanner::worker, this),
+: m_scanEngine(
+    readScanThreadCount(),
+    DirectoryReaderFactory::create(readDirectoryReaderType()),
+    // The watcher compares stamps to find directories changed after listing
+    readIncrementalRescan() || readLiveUpdate(),
+    readIncrementalRescan(),
+    [this](TPathId pathId, const QString& dirPath, const DirectoryDetails& dirDetails) {
+        prepareDtoAndNotifyEventSinks(pathId, dirPath, dirDetails);
+    },
+    [this]() { return isCancellationRequested(); }),
+  m_pWatcher(!readLiveUpdate() ? nullptr : std::make_unique<DirectoryWatcher>(
+    DirectoryReaderFactory::create(readDirectoryReaderType()),
+    [this](TPathId pathId, const QString& dirPath, const DirectoryDetails& dirDetails) {
+        prepareDtoAndNotifyEventSinks(pathId, dirPath, dirDetails);
+    })),
+  m_threadWorker(&DirectoryScanner::worker, this),
   m_threadNotifier(&DirectoryScanner::notifier, this)
 {
 }
@@ -38,13 +64,53 @@ DirectoryScanner::~DirectoryScanner()
     assert(!m_threadNotifier.joinable());
 }
 
+unsigned
+DirectoryScanner::readScanThreadCount()
+{
+    // 0 (default) stands for the number of hardware threads
+    bool ok = false;
+    unsigned threadCount = Settings::instance()->value(SCANNER_THREAD_COUNT_NAME, 0).toUInt(&ok);
+
+    return ok ? threadCount : 0;
+}
+
+DirectoryReaderType
+DirectoryScanner::readDirectoryReaderType()
+{
+    // "std" (default), "getdents" or "getdents_uring"
+    const QString& sReaderType = Settings::instance()->value(SCANNER_READER_NAME).toString();
+
+    return DirectoryReaderFactory::fromString(sReaderType);
+}
+
+bool
+DirectoryScanner::readIncrementalRescan()
+{
+    // Off (default): every directory is re-read on rescan.
+    // On: directories are re-read only if their own mtime/ctime/inode changed.
+    // N.B. Files rewritten in place (without creating, renaming or removing
+    //  any directory entry) are not detected then.
+    return Settings::instance()->value(SCANNER_INCREMENTAL_RESCAN_NAME, false).toBool();
+}
+
+bool
+DirectoryScanner::readLiveUpdate()
+{
+    // Watch scanned directories for changes (inotify, Linux only)
+    return Settings::instance()->value(SCANNER_LIVE_UPDATE_NAME, false).toBool();
+}
+
 void
 DirectoryScanner::setRootPath(const QString& rootPath)
 {
-    std::scoped_lock lock_(m_sync);
-    m_rootPath = getUnifiedPathName(rootPath);
+    {
+        std::scoped_lock lock_(m_sync);
+        m_rootPath = getUnifiedPathName(rootPath);
+
+        m_workStack.setRootPath(m_rootPath);
+    }
 
-    m_workStack.setRootPath(m_rootPath);
+    m_cvWorkAvailable.notify_one();
 }
 
 void
@@ -64,22 +130,30 @@ DirectoryScanner::fini()
 void
 DirectoryScanner::subscribe(IDirectoryScannerEventSink* eventSink)
 {
-	std::scoped_lock lock_(m_sync);
+	std::scoped_lock lock_(m_sync, m_syncNotifier);
 
 	assert(m_eventSinks.find(eventSink) == m_eventSinks.end());
 	m_eventSinks.emplace(eventSink);
+	m_sinkStates.emplace(eventSink, SinkState());
 }
 
 void
 DirectoryScanner::unsubscribe(IDirectoryScannerEventSink* eventSink)
 {
-	std::scoped_lock lock_(m_sync);
+	// Wait for events being dispatched to the sink
+	std::scoped_lock lock_(m_syncDispatch, m_sync, m_syncNotifier);
 
 	auto iter = m_eventSinks.find(eventSink);
 	assert(iter != m_eventSinks.end());
 
 	if (iter != m_eventSinks.end())
 		m_eventSinks.erase(iter);
+
+	m_sinkInterests.erase(eventSink);
+	m_sinkStates.erase(eventSink);
+
+	std::erase_if(m_pendingInterestChanges, [&](const PendingInterestChange& change) {
+		return change.eventSink == eventSink; });
 }
 
 void
@@ -88,25 +162,54 @@ DirectoryScanner::prepareDtoAndNotifyEventSinks(
     const DirectoryDetails& dirDetails,
     bool acquireLock)
 {
+    prepareDtoAndNotifyEventSinks(
+        PathTable::instance()->intern(dirPath), dirPath, dirDetails, acquireLock);
+}
+
+void
+DirectoryScanner::prepareDtoAndNotifyEventSinks(
+    TPathId pathId,
+    const QString& dirPath,
+    const DirectoryDetails& dirDetails,
+    bool acquireLock)
+{
+    bool sendMimeSizes = false;
+    {
+        std::unique_lock lock_(m_sync, std::defer_lock);
+        if (acquireLock)
+            lock_.lock();
+
+        // Nobody shows the directory at the moment, it is read from the data store once shown
+        if (!isDirInfoWanted(pathId))
+            return;
+
+        sendMimeSizes = nullptr != dirDetails.mimeDetailsList && isMimeSizesWanted(pathId);
+    }
+
     //
     // Prepare DTO
     //
 
     auto pDirInfo = std::make_shared<KDirectoryInfo>();
     pDirInfo->fullPath = dirPath;
+    pDirInfo->pathId = pathId;
     pDirInfo->assignStatsWithStatus(dirDetails);
 
-    bool sendMimeSizes = false;
-    KMimeSizesInfoPtr pMimeInfo;
-    if (dirDetails.mimeDetailsList.has_value())
+    DirectoryStats ownStats;
+    if (DirectoryStore::instance()->tryGetOwnStats(pathId, ownStats))
     {
-        sendMimeSizes = true;
+        pDirInfo->ownFileCount = ownStats.totalFileCount;
+        pDirInfo->ownSize = ownStats.totalSize;
+    }
 
+    KMimeSizesInfoPtr pMimeInfo;
+    if (sendMimeSizes)
+    {
         pMimeInfo = std::make_shared<KMimeSizesInfo>();
         pMimeInfo->fullPath = dirPath;
 
         KMapper::mapTMimeDetailsListToKMimeSizesList(
-            dirDetails.mimeDetailsList.value(), pMimeInfo->mimeSizes);
+            *dirDetails.mimeDetailsList, pMimeInfo->mimeSizes);
     }
 
     {
@@ -117,79 +220,292 @@ DirectoryScanner::prepareDtoAndNotifyEventSinks(
         postDirInfo(pDirInfo);
 
         if (sendMimeSizes)
-            postMimeSizesInfo(pMimeInfo);
+            postMimeSizesInfo(pathId, pMimeInfo);
+    }
+
+    {
+        std::scoped_lock lock_(m_syncNotifier);
+        m_eventsPosted = true;
+    }
+
+    m_cvNotifier.notify_one();
+}
+
+void
+DirectoryScanner::setDirectoryExpanded(
+    IDirectoryScannerEventSink* eventSink,
+    const QString& dirPath,
+    bool expanded)
+{
+    {
+        std::scoped_lock lock_(m_syncNotifier);
+        m_pendingInterestChanges.push_back(PendingInterestChange{
+            eventSink,
+            expanded ? PendingInterestChange::Kind::Expanded : PendingInterestChange::Kind::Collapsed,
+            dirPath });
+    }
+
+    m_cvNotifier.notify_one();
+}
+
+void
+DirectoryScanner::setDirectorySelected(IDirectoryScannerEventSink* eventSink, const QString& dirPath)
+{
+    {
+        std::scoped_lock lock_(m_syncNotifier);
+        m_pendingInterestChanges.push_back(PendingInterestChange{
+            eventSink,
+            PendingInterestChange::Kind::Selected,
+            dirPath });
+    }
+
+    m_cvNotifier.notify_one();
+}
+
+bool
+DirectoryScanner::applyPendingInterestChanges()
+{
+    std::vector<PendingInterestChange> pendingInterestChanges;
+    {
+        std::scoped_lock lock_(m_syncNotifier);
+        pendingInterestChanges.swap(m_pendingInterestChanges);
+    }
+
+    if (pendingInterestChanges.empty())
+        return false;
+
+    auto pPathTable = PathTable::instance();
+
+    for (const auto& change : pendingInterestChanges)
+    {
+        // The file system root (e.g. "My Computer") is a parent of top level directories
+        const QString& unifiedPath = getUnifiedPathName(change.path);
+        const TPathId pathId = unifiedPath.isEmpty() ?
+            InvalidPathId : pPathTable->intern(unifiedPath);
+
+        std::scoped_lock lock_(m_sync);
+
+        // Unsubscribed in between
+        if (m_eventSinks.find(change.eventSink) == m_eventSinks.end())
+            continue;
+
+        SinkInterest& interest = m_sinkInterests[change.eventSink];
+
+        switch (change.kind)
+        {
+        case PendingInterestChange::Kind::Expanded:
+            interest.expandedPathIds.insert(pathId);
+
+            // Children became visible
+            notifyFromStore(pPathTable->children(pathId));
+            break;
+
+        case PendingInterestChange::Kind::Collapsed:
+            interest.expandedPathIds.erase(pathId);
+            break;
+
+        case PendingInterestChange::Kind::Selected:
+            interest.selectedPathId = pathId;
+
+            // MIME type sizes are not sent for unselected directories, thus are always due
+            if (InvalidPathId != pathId)
+                notifyFromStore({ pathId });
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool
+DirectoryScanner::isDirInfoWanted(TPathId pathId) const
+{
+    // Some sink has not declared its interest
+    if (m_sinkInterests.size() < m_eventSinks.size())
+        return true;
+
+    const TPathId parentId = PathTable::instance()->parent(pathId);
+
+    for (const auto& [eventSink, interest] : m_sinkInterests)
+    {
+        if (interest.selectedPathId == pathId || interest.expandedPathIds.contains(parentId))
+            return true;
+    }
+
+    return false;
+}
+
+bool
+DirectoryScanner::isMimeSizesWanted(TPathId pathId) const
+{
+    if (m_sinkInterests.size() < m_eventSinks.size())
+        return true;
+
+    for (const auto& [eventSink, interest] : m_sinkInterests)
+    {
+        if (interest.selectedPathId == pathId)
+            return true;
+    }
+
+    return false;
+}
+
+void
+DirectoryScanner::notifyFromStore(const std::vector<TPathId>& pathIds)
+{
+    // Called under m_sync: scanning results are put to the data store before being posted,
+    //  so a concurrent update is either read here or posted after this one
+    auto pPathTable = PathTable::instance();
+
+    for (auto pathId : pathIds)
+    {
+        // Not shown, so not read from the data store
+        if (!isDirInfoWanted(pathId))
+            continue;
+
+        DirectoryDetails dirDetails;
+        if (DirectoryStore::instance()->tryGetDirectory(pathId, false, dirDetails))
+            prepareDtoAndNotifyEventSinks(pathId, pPathTable->path(pathId), dirDetails, false);
     }
 }
 
+void
+DirectoryScanner::notifyDirectoriesStored(const std::vector<TPathId>& pathIds)
+{
+    std::scoped_lock lock_(m_sync);
+    notifyFromStore(pathIds);
+}
+
 void
 DirectoryScanner::postDirInfo(KDirectoryInfoPtr pDirInfo)
 {
-    const auto& dirPath = pDirInfo->fullPath;
+    const auto pathId = pDirInfo->pathId;
 
-    auto iter = m_dirInfos.find(dirPath);
+    auto iter = m_dirInfos.find(pathId);
     if (iter == m_dirInfos.end())
-        m_dirInfos.emplace(std::make_pair(dirPath, pDirInfo));
+        m_dirInfos.emplace(std::make_pair(pathId, pDirInfo));
     else
         // Repace with newer one
         iter->second = pDirInfo;
 }
 
 void
-DirectoryScanner::postMimeSizesInfo(KMimeSizesInfoPtr pMimeSizesInfo)
+DirectoryScanner::postMimeSizesInfo(TPathId pathId, KMimeSizesInfoPtr pMimeSizesInfo)
 {
-    const auto& dirPath = pMimeSizesInfo->fullPath;
-
-    auto iter = m_mimeSizesInfos.find(dirPath);
+    auto iter = m_mimeSizesInfos.find(pathId);
     if (iter == m_mimeSizesInfos.end())
-        m_mimeSizesInfos.emplace(std::make_pair(dirPath, pMimeSizesInfo));
+        m_mimeSizesInfos.emplace(std::make_pair(pathId, pMimeSizesInfo));
     else
         // Repace with newer one
         iter->second = pMimeSizesInfo;
 }
 
 void
-DirectoryScanner::requestCancellationAndWait(std::unique_lock<std::mutex>& lock_)
+DirectoryScanner::detachScanAndWait(std::unique_lock<std::mutex>& lock_)
 {
-    auto resetCancellationRequest = scope_guard([&](auto) {
-        m_isCancellationRequested = false;
-    });
-
-    // Wait for scanDirectory() to finish before changing the task stack
-    m_isCancellationRequested = true;
+    // Wait for the worker thread to return from the scan engine before changing the task stack
+    m_scanEngine.detachFocusedScans();
     m_scanningDone.wait(lock_, [&] { return !m_isScanRunning; });
 }
 
 void
 DirectoryScanner::setFocusedPath(const QString& dirPath)
 {
-    std::unique_lock lock_(m_syncPendingFocusedParentPath);
+    // Called on UI thread, thus only posts the request to the notifier thread
+    {
+        std::scoped_lock lock_(m_syncNotifier);
+        m_pendingFocusedParentPath = PendingFocusedParentPath{ dirPath, std::chrono::steady_clock::now() };
+    }
 
-    m_pendingFocusedParentPath = PendingFocusedParentPath{ dirPath };
+    m_cvNotifier.notify_one();
 }
 
 std::future<DirectoryProcessingStatus>
-DirectoryScanner::setFocusedPathAndGetFuture(const QString& dirPath)
+DirectoryScanner::scanInBackgroundAndGetFuture(const QString& dirPath)
 {
-    std::unique_lock lock_(m_syncPendingFocusedParentPath);
+    return std::async(std::launch::async, [this, dirPath] {
+        KDBG_CURRENT_THREAD_NAME(L"DirectoryScanner::scanInBackground");
+        return scanInBackground(dirPath);
+    });
+}
+
+DirectoryProcessingStatus
+DirectoryScanner::scanInBackground(const QString& dirPath)
+{
+    const QString& unifiedPath = getUnifiedPathName(dirPath);
+    const TPathId pathId = PathTable::instance()->intern(unifiedPath);
+
+    // Check if scanned before
+    DirectoryDetails dirDetails;
+    if (DirectoryStore::instance()->tryGetDirectory(pathId, true, dirDetails) &&
+        (DirectoryProcessingStatus::Ready == dirDetails.status ||
+         DirectoryProcessingStatus::Error == dirDetails.status))
+    {
+        return dirDetails.status;
+    }
+
+    // Check if skipped (only after checking if scanned before in order to avoid multiple scans)
+    if (!DirectoryScanSwitch::instance()->isEnabled(pathId))
+    {
+        dirDetails = DirectoryDetails();
+        dirDetails.status = DirectoryProcessingStatus::Skipped;
 
-    auto pPromise = std::make_shared<WorkState::TPromise>();
-    auto fut = pPromise->get_future();
+        DirectoryStore::instance()->upsertDirectory(pathId, dirDetails, true);
+        prepareDtoAndNotifyEventSinks(pathId, unifiedPath, dirDetails);
 
-    m_pendingFocusedParentPath = PendingFocusedParentPath{ dirPath, pPromise };
+        return dirDetails.status;
+    }
 
-    // Wait until pending value is picked up by a worker thread
-    m_cvFocusedParentPath.wait(lock_);
-    lock_.unlock();
+    dirDetails.status = DirectoryProcessingStatus::Scanning;
+    DirectoryStore::instance()->upsertDirectory(pathId, dirDetails, false);
+    prepareDtoAndNotifyEventSinks(pathId, unifiedPath, dirDetails);
 
-    return fut;
+    try
+    {
+        DirectoryStats stats;
+        TMimeDetailsList mimeSizes;
+        auto res = m_scanEngine.scanTree(
+            unifiedPath,
+            ParallelScanEngine::ScanPriority::Background,
+            m_scanEngine.getDetachEpoch(),
+            stats,
+            mimeSizes);
+
+        if (ParallelScanEngine::ScanTreeResult::Complete == res)
+        {
+            dirDetails.DirectoryStats::assignStats(stats);
+            dirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(std::move(mimeSizes));
+            dirDetails.status = DirectoryProcessingStatus::Ready;
+
+            if (m_pWatcher)
+                m_pWatcher->watchSubtree(pathId);
+        }
+        else
+        {
+            // Cancelled, results of already finished subdirectories are kept in the data store
+            dirDetails.status = DirectoryProcessingStatus::Pending;
+            DirectoryStore::instance()->upsertDirectory(pathId, dirDetails, false);
+        }
+    }
+    catch (const std::exception& x)
+    {
+        qCritical() << "ERROR: " << x.what() << endl;
+
+        dirDetails.status = DirectoryProcessingStatus::Error;
+        DirectoryStore::instance()->upsertDirectory(pathId, dirDetails, false);
+    }
+
+    prepareDtoAndNotifyEventSinks(pathId, unifiedPath, dirDetails);
+
+    return dirDetails.status;
 }
 
-void
+bool
 DirectoryScanner::checkPendingFocusedParentPathAssignment()
 {
     std::optional<PendingFocusedParentPath> pendingFocusedParentPath;
     {
-        std::scoped_lock lock_(m_syncPendingFocusedParentPath);
+        std::scoped_lock lock_(m_syncNotifier);
 
         if (m_pendingFocusedParentPath.has_value())
         {
@@ -198,42 +514,38 @@ DirectoryScanner::checkPendingFocusedParentPathAssignment()
         }
     }
 
-    if (pendingFocusedParentPath.has_value())
+    if (!pendingFocusedParentPath.has_value())
+        return false;
+
+    const QString& dirPath = pendingFocusedParentPath.value().path;
     {
-        setFocusedPathWithLocking(
-            pendingFocusedParentPath.value().path,
-            pendingFocusedParentPath.value().pPromise);
+        std::scoped_lock lock_(m_sync);
 
-        // Notify UI thread
-        m_cvFocusedParentPath.notify_all();
+        m_focusRequestPathId = PathTable::instance()->intern(getUnifiedPathName(dirPath));
+        m_focusRequestTime = pendingFocusedParentPath.value().requestTime;
     }
-}
 
-void
-DirectoryScanner::resetFocusedPathWithLocking()
-{
-    std::unique_lock lock_(m_sync);
+    setFocusedPathWithLocking(dirPath);
+    m_cvWorkAvailable.notify_one();
 
-    m_workStack.setFocusedPath();
-
-    requestCancellationAndWait(lock_);
-
-    while (!m_workStack.empty())
-        popScanDirectoryAndSetPending();
+    return true;
 }
 
 void
-DirectoryScanner::setFocusedPathWithLocking(
-    const QString& dirPath,
-    WorkState::TPromisePtr pPromise)
+DirectoryScanner::setFocusedPathWithLocking(const QString& dirPath)
 {
     QString unifiedPath = getUnifiedPathName(dirPath);
 
     std::unique_lock lock_(m_sync);
 
+    m_isFocusChanging = true;
+    auto endFocusChanging = scope_guard([&](auto) {
+        m_isFocusChanging = false;
+    });
+
     m_workStack.setFocusedPath(unifiedPath);
 
-    requestCancellationAndWait(lock_);
+    detachScanAndWait(lock_);
 
     // Cancel all tasks up to the shared parent (between current and focused)
     while (!m_workStack.empty())
@@ -292,13 +604,6 @@ DirectoryScanner::setFocusedPathWithLocking(
 
         m_workStack.pushScanDirectory(wState);
     }
-
-    // Assign promise
-    if (pPromise)
-    {
-        assert(!m_workStack.empty());
-        m_workStack.top().pPromise = pPromise;
-    }
 }
 
 void
@@ -336,22 +641,31 @@ DirectoryScanner::isDestroying() const noexcept
 bool
 DirectoryScanner::isCancellationRequested() const noexcept
 {
-    std::scoped_lock lock_(m_sync);
-    return m_isCancellationRequested;
+    // Polled by the scan engine for every directory entry
+    return m_isCancellationRequested.load(std::memory_order_relaxed);
 }
 
 void
 DirectoryScanner::stopWorker() noexcept
 {
     {
-        std::scoped_lock lock_(m_sync);
+        std::scoped_lock lock_(m_sync, m_syncNotifier);
         m_stopWorker = true;
         m_isCancellationRequested = true;
     }
 
+    m_cvWorkAvailable.notify_all();
+    m_cvNotifier.notify_all();
+
     m_threadWorker.join();
     m_threadNotifier.join();
 
+    // The worker thread has returned from the scan engine
+    m_scanEngine.fini();
+
+    if (m_pWatcher)
+        m_pWatcher->fini();
+
     // Pop remaining work items from the stack so that possible promises would be handled
     {
         std::scoped_lock lock_(m_sync);
@@ -362,6 +676,14 @@ DirectoryScanner::stopWorker() noexcept
     }
 }
 
+bool
+DirectoryScanner::hasRunnableTask() const
+{
+    // Do not scan paths in focus, nor the stack being rebuilt
+    return !m_isFocusChanging &&
+        !m_workStack.empty() && !m_workStack.isAboveOrEqualFocusedPath(m_workStack.top().fullPath);
+}
+
 void
 DirectoryScanner::worker()
 {
@@ -380,27 +702,22 @@ DirectoryScanner::worker()
             // Select task
             WorkState* workState = nullptr;
             QString workDirPath;
+            unsigned detachEpoch = 0;
             {
                 std::unique_lock lock_(m_sync);
 
-                if (m_workStack.empty())
-                {
-                    lock_.unlock();
-                    std::this_thread::sleep_for(100ms);
-                    continue;
-                }
+                // Wait for work to arrive, focus to change or shutdown
+                m_cvWorkAvailable.wait(lock_, [&] { return m_stopWorker || hasRunnableTask(); });
+
+                if (m_stopWorker)
+                    break;
 
                 m_isScanRunning = true;
                 workState = &m_workStack.top();
                 workDirPath = workState->fullPath;
 
-                // Do not scan paths in focus
-                if (m_workStack.isAboveOrEqualFocusedPath(workDirPath))
-                {
-                    lock_.unlock();
-                    std::this_thread::sleep_for(100ms);
-                    continue;
-                }
+                // A focus change from now on detaches the scan
+                detachEpoch = m_scanEngine.getDetachEpoch();
             }
 
             DirectoryDetails workDirDetails;
@@ -427,28 +744,47 @@ DirectoryScanner::worker()
             {
                 try
                 {
-                    // After scanDirectory the stack might change
-                    auto unsetWorkState = scope_guard([&](auto) {   
-                        workState = nullptr;
-                    });
-
                     prepareDtoAndNotifyEventSinks(workDirPath, workDirDetails);
 
-                    bool scanned = scanDirectory(workState);
-
-                    workDirDetails.DirectoryStats::assignStats(*workState);
-                    workDirDetails.mimeDetailsList = workState->mimeSizes;
-
-                    if (scanned)
+                    // The work stack is not changed until the scan engine returns,
+                    //  since focus change waits for the scan to stop running
+                    DirectoryStats stats;
+                    TMimeDetailsList mimeSizes;
+                    auto res = m_scanEngine.scanTree(
+                        workDirPath,
+                        ParallelScanEngine::ScanPriority::Focused,
+                        detachEpoch,
+                        stats,
+                        mimeSizes);
+
+                    if (ParallelScanEngine::ScanTreeResult::Complete == res)
                     {
+                        workDirDetails.DirectoryStats::assignStats(stats);
+                        workDirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(std::move(mimeSizes));
                         workDirDetails.status = DirectoryProcessingStatus::Ready;
 
-                        std::scoped_lock lock_(m_sync);
+                        bool ready = false;
+                        {
+                            std::scoped_lock lock_(m_sync);
+
+                            assert(workState == &m_workStack.top() && workDirPath == workState->fullPath);
+                            workState->assignStats(stats);
+                            workState->mimeSizes = *workDirDetails.mimeDetailsList;
 
-                        assert(workDirPath == m_workStack.top().fullPath);
-                        m_workStack.popScanDirectory(!m_isCancellationRequested ?
-                            DirectoryProcessingStatus::Ready :
-                            DirectoryProcessingStatus::Pending);
+                            ready = !m_isCancellationRequested;
+                            m_workStack.popScanDirectory(ready ?
+                                DirectoryProcessingStatus::Ready :
+                                DirectoryProcessingStatus::Pending);
+                        }
+
+                        if (ready && m_pWatcher)
+                            m_pWatcher->watchSubtree(PathTable::instance()->intern(workDirPath));
+                    }
+                    else
+                    {
+                        // Cancelled or detached. Results of already finished subdirectories are kept
+                        //  in the data store, a detached scan puts the rest there on completion.
+                        continue;
                     }
                 }
                 catch (const std::exception& x)
@@ -479,36 +815,73 @@ DirectoryScanner::notifier()
 
     try
     {
-        while (!isDestroying())
+        while (true)
         {
-            std::this_thread::sleep_for(500ms);
+            {
+                std::unique_lock lock_(m_syncNotifier);
 
-            // Check if focused path has not changed
-            checkPendingFocusedParentPathAssignment();
+                // Wait for a focus or interest change, events or shutdown...
+                m_cvNotifier.wait(lock_, [&] {
+                    return m_stopWorker || m_pendingFocusedParentPath.has_value() ||
+                        !m_pendingInterestChanges.empty() || m_eventsPosted; });
 
-            std::scoped_lock lock_(m_sync);
+                // ...collecting events during the rest of the interval
+                if (!m_pendingFocusedParentPath.has_value() && m_pendingInterestChanges.empty())
+                {
+                    m_cvNotifier.wait_until(lock_, m_lastNotifyTime + NOTIFY_INTERVAL, [&] {
+                        return m_stopWorker || m_pendingFocusedParentPath.has_value() ||
+                            !m_pendingInterestChanges.empty(); });
+                }
+
+                if (m_stopWorker)
+                    break;
+            }
+
+            // Deliver directories which got shown without delay
+            if (applyPendingInterestChanges())
+            {
+                m_lastNotifyTime = {};
+                continue;
+            }
+
+            // Check if focused path has not changed
+            if (checkPendingFocusedParentPathAssignment())
+            {
+                // Let the first results of the new focus through without delay
+                m_lastNotifyTime = {};
+                continue;
+            }
 
             //
             // Extract currently collected events
             //
 
             TDirInfoDTOs dirInfos;
-            dirInfos.swap(m_dirInfos);
-
             TMimeSizesInfoDTOs mimeSizesInfos;
-            mimeSizesInfos.swap(m_mimeSizesInfos);
-
-            // Update all hungry event subscribers
-            for (auto sink : m_eventSinks)
             {
-                assert(sink);
+                std::scoped_lock lock_(m_sync);
+                m_lastNotifyTime = std::chrono::steady_clock::now();
 
-                for (const auto& pairDirInfo : dirInfos)
-                    sink->onUpdateDirectoryInfo(pairDirInfo.second);
+                {
+                    std::scoped_lock lockNotifier_(m_syncNotifier);
+                    m_eventsPosted = false;
+                }
 
-                for (const auto& pairMimeSizesInfo : mimeSizesInfos)
-                    sink->onUpdateMimeSizes(pairMimeSizesInfo.second);
+                dirInfos.swap(m_dirInfos);
+                mimeSizesInfos.swap(m_mimeSizesInfos);
+
+                if (m_focusRequestTime.has_value() && dirInfos.contains(m_focusRequestPathId))
+                {
+                    const std::chrono::duration<double, std::milli> latency =
+                        m_lastNotifyTime - m_focusRequestTime.value();
+                    qCDebug(lcDiagnostics) << "Selection to first DTO latency:" << latency.count() << "ms";
+
+                    m_focusRequestTime.reset();
+                }
             }
+
+            // The worker thread is not blocked while event subscribers are updated
+            dispatchEvents(dirInfos, mimeSizesInfos);
         }
     }
     catch (...)
@@ -518,111 +891,111 @@ DirectoryScanner::notifier()
 }
 
 void
-DirectoryScanner::handleWorkerException(std::exception_ptr&& pEx) noexcept
+DirectoryScanner::dispatchEvents(const TDirInfoDTOs& dirInfos, const TMimeSizesInfoDTOs& mimeSizesInfos)
 {
-    std::scoped_lock lock_(m_sync);
+    std::scoped_lock lockDispatch_(m_syncDispatch);
 
-    // Update all event subscribers
-    for (auto sink : m_eventSinks)
+    std::vector<std::pair<IDirectoryScannerEventSink*, KScanUpdateBatchPtr>> batches;
     {
-        assert(sink);
+        std::scoped_lock lock_(m_syncNotifier);
 
-        try
-        {
-            sink->onWorkerException(std::move(pEx));
-        }
-        catch (...)
+        for (auto& [eventSink, sinkState] : m_sinkStates)
         {
-            assert(0);
+            // Newer DTOs replace the ones which are not delivered yet
+            for (const auto& pairDirInfo : dirInfos)
+                sinkState.dirInfos.insert_or_assign(pairDirInfo.first, pairDirInfo.second);
+
+            for (const auto& pairMimeSizesInfo : mimeSizesInfos)
+                sinkState.mimeSizesInfos.insert_or_assign(pairMimeSizesInfo.first, pairMimeSizesInfo.second);
+
+            // Back-pressure: a slow sink gets coalesced updates later
+            if (sinkState.busy || (sinkState.dirInfos.empty() && sinkState.mimeSizesInfos.empty()))
+                continue;
+
+            batches.emplace_back(eventSink, makeBatch(eventSink, sinkState));
         }
     }
-}
 
-void
-DirectoryScanner::setScanRunning(bool running)
-{
-    std::scoped_lock lock_(m_sync);
-    m_isScanRunning = running;
+    // Update all hungry event subscribers
+    for (auto& [eventSink, pBatch] : batches)
+    {
+        assert(eventSink);
+        eventSink->onUpdateBatch(std::move(pBatch));
+    }
 }
 
-bool
-DirectoryScanner::scanDirectory(WorkState* workState)
+KScanUpdateBatchPtr
+DirectoryScanner::makeBatch(IDirectoryScannerEventSink* eventSink, SinkState& sinkState)
 {
-    assert(workState && isUnifiedPath(workState->fullPath));
+    auto pBatch = new KScanUpdateBatch();
 
-    if (isCancellationRequested())
-        return false;
-
-    unsigned long itemCount = 0;
+    pBatch->dirInfos.reserve(sinkState.dirInfos.size());
+    for (auto& pairDirInfo : sinkState.dirInfos)
+        pBatch->dirInfos.emplace_back(std::move(pairDirInfo.second));
 
-    // If scanning is not started create a directory/file iterator
-    if (!workState->pDirIterator)
-    {
-        workState->pDirIterator = std::make_shared<std::filesystem::directory_iterator>(
-            workState->fullPath.toStdWString());
-    }
+    pBatch->mimeSizesInfos.reserve(sinkState.mimeSizesInfos.size());
+    for (auto& pairMimeSizesInfo : sinkState.mimeSizesInfos)
+        pBatch->mimeSizesInfos.emplace_back(std::move(pairMimeSizesInfo.second));
 
-    if (!workState->subdirectoryCount.has_value())
-        workState->subdirectoryCount = 0;
+    sinkState.dirInfos.clear();
+    sinkState.mimeSizesInfos.clear();
+    sinkState.busy = true;
 
-    if (!workState->totalFileCount.has_value())
-        workState->totalFileCount = 0;
-
-    if (!workState->totalSize.has_value())
-        workState->totalSize = 0;
+    // The sink is ready for the next batch as soon as it releases this one
+    return KScanUpdateBatchPtr(pBatch, [this, eventSink](const KScanUpdateBatch* pBatch) {
+        delete pBatch;
+        onBatchReleased(eventSink);
+    });
+}
 
-    auto& dirIterator = *workState->pDirIterator;
-    for (const auto& entry : dirIterator)
+void
+DirectoryScanner::onBatchReleased(IDirectoryScannerEventSink* eventSink)
+{
     {
-        if (entry.is_symlink())
-            continue;
+        std::scoped_lock lock_(m_syncNotifier);
 
-        const auto& fullPath_ = entry.path().wstring();
-        const QString& fullPath = getUnifiedPathName(QString::fromStdWString(fullPath_));
+        // Might be unsubscribed already
+        auto iter = m_sinkStates.find(eventSink);
+        if (m_sinkStates.end() == iter)
+            return;
 
-        if (entry.is_directory())
-        {
-            workState->subdirectoryCount = workState->subdirectoryCount.value() + 1;
+        SinkState& sinkState = iter->second;
+        sinkState.busy = false;
 
-            // New task
-            WorkState wState;
-            wState.fullPath = fullPath;
+        // Deliver updates collected in the meantime
+        if (sinkState.dirInfos.empty() && sinkState.mimeSizesInfos.empty())
+            return;
 
-            // It's still valid but reset anyway
-            workState = 0;
+        m_eventsPosted = true;
+    }
 
-            std::scoped_lock lock_(m_sync);
-            m_workStack.pushScanDirectory(wState);
+    m_cvNotifier.notify_one();
+}
 
-            // Scanning of this directory will be resumed
-            // when the just created task is complete.
+void
+DirectoryScanner::handleWorkerException(std::exception_ptr&& pEx) noexcept
+{
+    std::scoped_lock lock_(m_sync);
 
-            // dirIterator is moved forward in case of successful child task completion
+    // Update all event subscribers
+    for (auto sink : m_eventSinks)
+    {
+        assert(sink);
 
-            return false;
-        }
-        else if (entry.is_regular_file())
+        try
         {
-            auto extension_ = entry.path().extension().wstring();
-            if (L'.' == extension_[0])
-                extension_ = extension_.substr(1);
-
-            const QString& extension = QString::fromStdWString(extension_);
-
-            auto fileSize = entry.file_size();
-
-            workState->totalSize = workState->totalSize.value() + fileSize;
-            workState->totalFileCount = workState->totalFileCount.value() + 1;
-
-            workState->mimeSizes.addMimeDetails(TMimeDetailsList::ALL_MIMETYPE, fileSize, 1);
-            workState->mimeSizes.addMimeDetails(extension, fileSize, 1);
+            sink->onWorkerException(std::move(pEx));
         }
-
-        if (0 == ++itemCount % 100 && isCancellationRequested())
+        catch (...)
         {
-            return false;
+            assert(0);
         }
     }
+}
 
-    return true;
+void
+DirectoryScanner::setScanRunning(bool running)
+{
+    std::scoped_lock lock_(m_sync);
+    m_isScanRunning = running;
 }
@@ -2,12 +2,20 @@
 #define DIRECTORYSCANNER_H
 
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <stack>
 #include <filesystem>
+#include <chrono>
 
 #include "IDirectoryScannerEventSink.h"
+#include "ParallelScanEngine.h"
+#include "DirectoryWatcher.h"
+#include "DirectoryReaderFactory.h"
 #include "model/WorkStack.h"
 
 class DirectoriesScanOrchestrator;
@@ -29,6 +37,15 @@ public:
 	void subscribe(IDirectoryScannerEventSink* eventSink);
 	void unsubscribe(IDirectoryScannerEventSink* eventSink);
 
+	// Interest of an event sink: the directories it shows, i.e. children of expanded directories
+	//	and the selected directory, the only one whose MIME type sizes are needed.
+	// DTOs are built only for directories of interest, updates of the other ones are dropped.
+	//	Directories which get into the interest are delivered from the data store.
+	// A sink which has never declared its interest gets updates of all directories.
+	// Called on UI thread, thus only post the request to the notifier thread.
+	void setDirectoryExpanded(IDirectoryScannerEventSink* eventSink, const QString& dirPath, bool expanded);
+	void setDirectorySelected(IDirectoryScannerEventSink* eventSink, const QString& dirPath);
+
 
 
 protected:
@@ -36,9 +53,14 @@ protected:
 	// These methods are hid from client code so that DirectoriesScanOrchestrator would be used instead.
 	//
 
+	// Focused directories are scanned first, the previously focused one is not cancelled
 	void setFocusedPath(const QString& dirPath);
-	std::future<DirectoryProcessingStatus> setFocusedPathAndGetFuture(const QString& dirPath);
-	void resetFocusedPathWithLocking();
+
+	// Scans dirPath with background priority regardless of the focused path
+	std::future<DirectoryProcessingStatus> scanInBackgroundAndGetFuture(const QString& dirPath);
+
+	// Delivers directories put to the data store by others (e.g. loaded from a snapshot)
+	void notifyDirectoriesStored(const std::vector<TPathId>& pathIds);
 
 private:
 	DirectoryScanner();
@@ -54,17 +76,42 @@ private:
 	struct PendingFocusedParentPath
 	{
 		QString path;
-		WorkState::TPromisePtr pPromise;
+		std::chrono::steady_clock::time_point requestTime;
 	};
 
-	mutable std::mutex m_syncPendingFocusedParentPath;
-	mutable std::condition_variable m_cvFocusedParentPath; // For notification that value is picked up
+	// Never held for long, so that UI thread requests return immediately.
+	// Protects the pending focus request and notifier wakeup conditions.
+	// N.B. May be acquired while holding m_sync, not vice versa.
+	mutable std::mutex m_syncNotifier;
 	std::optional<PendingFocusedParentPath> m_pendingFocusedParentPath; // Waiting for being set
+	bool m_eventsPosted = false;
 
-	void checkPendingFocusedParentPathAssignment();
-	void setFocusedPathWithLocking(
-		const QString& dirPath,
-		WorkState::TPromisePtr pPromise);
+	// A request to change interest of an event sink
+	struct PendingInterestChange
+	{
+		enum class Kind
+		{
+			Expanded,
+			Collapsed,
+			Selected
+		};
+
+		IDirectoryScannerEventSink* eventSink;
+		Kind kind;
+		QString path;
+	};
+
+	std::vector<PendingInterestChange> m_pendingInterestChanges; // Waiting for being applied
+
+	// Selection to first DTO latency, measured for the last focus request
+	TPathId m_focusRequestPathId = InvalidPathId;
+	std::optional<std::chrono::steady_clock::time_point> m_focusRequestTime;
+
+	// Returns true if the focused path has been changed
+	bool checkPendingFocusedParentPathAssignment();
+	void setFocusedPathWithLocking(const QString& dirPath);
+
+	DirectoryProcessingStatus scanInBackground(const QString& dirPath);
 
 	void popScanDirectoryAndSetPending();
 
@@ -74,35 +121,74 @@ private:
 	// Data update event subscribers
 	std::set<IDirectoryScannerEventSink*> m_eventSinks;
 
+	struct SinkInterest
+	{
+		std::unordered_set<TPathId> expandedPathIds; // InvalidPathId for the file system root
+		TPathId selectedPathId = InvalidPathId;
+	};
+
+	std::map<IDirectoryScannerEventSink*, SinkInterest> m_sinkInterests;
+
+	bool isDirInfoWanted(TPathId pathId) const;
+	bool isMimeSizesWanted(TPathId pathId) const;
+
+	// Applies interest changes on the notifier thread, returns true if any
+	bool applyPendingInterestChanges();
+
+	// Posts DTOs built from the data store
+	void notifyFromStore(const std::vector<TPathId>& pathIds);
+
 	void prepareDtoAndNotifyEventSinks(
 		const QString& dirPath,
 		const DirectoryDetails& dirDetails,
 		bool acquireLock = true);
+	void prepareDtoAndNotifyEventSinks(
+		TPathId pathId,
+		const QString& dirPath,
+		const DirectoryDetails& dirDetails,
+		bool acquireLock = true);
 	void postDirInfo(KDirectoryInfoPtr pDirInfo);
-	void postMimeSizesInfo(KMimeSizesInfoPtr pDirInfo);
-
-	// Returns true in case of scuccessful completion.
-	// Retuns false in case of cancellation or pause.
-	bool scanDirectory(WorkState* workState);
+	void postMimeSizesInfo(TPathId pathId, KMimeSizesInfoPtr pDirInfo);
 
 	//
 	// Work thread -related members
 	//
 
+	// Scans directories picked by the worker thread from the work stack (focused)
+	//	and the ones requested by DirectoriesScanOrchestrator (background).
+	// N.B. Must be declared (thus constructed) before the worker thread.
+	ParallelScanEngine m_scanEngine;
+
+	static unsigned readScanThreadCount();
+	static DirectoryReaderType readDirectoryReaderType();
+	static bool readIncrementalRescan();
+	static bool readLiveUpdate();
+
+	// Keeps scanned subtrees up to date, null unless live update is enabled
+	std::unique_ptr<DirectoryWatcher> m_pWatcher;
+
 	std::thread m_threadWorker;
-	bool m_stopWorker = false;
-	bool m_isCancellationRequested = false;
+	std::condition_variable m_cvWorkAvailable; // Work stack or focus change, shutdown
+	bool m_stopWorker = false; // Protected by both m_sync and m_syncNotifier
+	std::atomic<bool> m_isCancellationRequested = false;
 	bool m_isScanRunning = false;
 	std::condition_variable m_scanningDone;
 
+	// Set while the focus is being changed (from detaching the running scan until the work
+	//	stack is rebuilt), so that the worker would not restart the scan it has just been detached from
+	bool m_isFocusChanging = false;
+
 	void setScanRunning(bool running);
 
-	void requestCancellationAndWait(std::unique_lock<std::mutex>& lock_);
+	// The running focused scan goes on in the background, while the worker thread is released
+	void detachScanAndWait(std::unique_lock<std::mutex>& lock_);
 	bool isCancellationRequested() const noexcept;
 
 	bool isDestroying() const noexcept;
 	void stopWorker() noexcept;
 
+	bool hasRunnableTask() const;
+
 	void worker();
 
 	//
@@ -110,23 +196,48 @@ private:
 	//
 
 	std::thread m_threadNotifier;
+	std::condition_variable m_cvNotifier; // Focus change, posted DTOs, shutdown
+
+	// DTOs are dispatched at most once per interval, except for the first ones after a focus change
+	std::chrono::steady_clock::time_point m_lastNotifyTime;
 
 	// Directory update DTOs (for directory tree widget)
 	typedef std::map<
-		QString,	// Unified path
+		TPathId,	// Interned unified path
 		KDirectoryInfoPtr
 	> TDirInfoDTOs;
 	TDirInfoDTOs m_dirInfos;
 
 	// MIME type total size update DTOs (for MIME total sizes table)
 	typedef std::map<
-		QString,	// Unified path
+		TPathId,	// Interned unified path
 		KMimeSizesInfoPtr
 	> TMimeSizesInfoDTOs;
 	TMimeSizesInfoDTOs m_mimeSizesInfos;
 
+	// Delivery state of an event sink, protected by m_syncNotifier
+	struct SinkState
+	{
+		// The last delivered batch is not released by the sink yet
+		bool busy = false;
+
+		// Updates waiting for the sink to become ready
+		TDirInfoDTOs dirInfos;
+		TMimeSizesInfoDTOs mimeSizesInfos;
+	};
+
+	std::map<IDirectoryScannerEventSink*, SinkState> m_sinkStates;
+
+	// Held while dispatching to sinks (outside of m_sync), so that unsubscribe() would wait for it.
+	// N.B. Acquired before m_sync and m_syncNotifier.
+	std::mutex m_syncDispatch;
+
 	void notifier();
 
+	void dispatchEvents(const TDirInfoDTOs& dirInfos, const TMimeSizesInfoDTOs& mimeSizesInfos);
+	KScanUpdateBatchPtr makeBatch(IDirectoryScannerEventSink* eventSink, SinkState& sinkState);
+	void onBatchReleased(IDirectoryScannerEventSink* eventSink);
+
 	// Work threads' errors handling
 	void handleWorkerException(std::exception_ptr&& pEx) noexcept;
 };
@@ -0,0 +1,605 @@
+#include <cassert>
+#include <cerrno>
+#include <algorithm>
+#include <iterator>
+#include <system_error>
+#include <QDebug>
+#include <QFile>
+
+#include "config.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif // __linux__
+
+#include "DirectoryWatcher.h"
+#include "model/DirectoryScanSwitch.h"
+#include "model/DirectoryStore.h"
+#include "utils.h"
+
+// Changes of a directory are applied once there are no more events for this long...
+#define WATCH_SETTLE_TIME_MS 200
+
+// ...but not later than this after the first change
+#define WATCH_MAX_DELAY_MS 2000
+
+#define WATCH_EVENT_BUFFER_SIZE (64 * 1024)
+
+namespace
+{
+    // Collects a directory listing
+    class ListingCollector : public IDirectoryEntrySink
+    {
+    public:
+        explicit ListingCollector(TPathId pathId)
+        : m_pathId(pathId)
+        {
+            listing.ownStats = DirectoryStats{ .subdirectoryCount = 0, .totalFileCount = 0, .totalSize = 0 };
+        }
+
+        DirectoryListing listing;
+
+        virtual bool onSubdirectory(const QString& name) override
+        {
+            listing.ownStats.subdirectoryCount = listing.ownStats.subdirectoryCount.value() + 1;
+            listing.subdirectories.push_back(PathTable::instance()->internChild(m_pathId, name));
+
+            return true;
+        }
+
+        virtual bool onRegularFile(TExtensionId extensionId, unsigned long long fileSize) override
+        {
+            listing.ownStats.totalSize = listing.ownStats.totalSize.value() + fileSize;
+            listing.ownStats.totalFileCount = listing.ownStats.totalFileCount.value() + 1;
+
+            listing.ownMimeSizes.addMimeDetails(TMimeDetailsList::ALL_MIMETYPE_ID, fileSize, 1);
+            listing.ownMimeSizes.addMimeDetails(extensionId, fileSize, 1);
+
+            return true;
+        }
+
+    private:
+        const TPathId m_pathId;
+    };
+}
+
+#ifdef __linux__
+
+DirectoryWatcher::DirectoryWatcher(std::unique_ptr<IDirectoryReader> pReader, TNotifyCallback notify)
+: m_pReader(std::move(pReader)),
+  m_notify(std::move(notify))
+{
+    assert(m_pReader);
+
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (0 > m_inotifyFd)
+    {
+        qCritical() << "ERROR: inotify is not available, live update is disabled, errno:" << errno << endl;
+        return;
+    }
+
+    m_stopEventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (0 > m_stopEventFd)
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+
+    m_thread = std::thread(&DirectoryWatcher::watcher, this);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    assert(!m_thread.joinable());
+}
+
+void
+DirectoryWatcher::fini()
+{
+    if (m_thread.joinable())
+    {
+        const uint64_t value = 1;
+        [[maybe_unused]] auto res = ::write(m_stopEventFd, &value, sizeof(value));
+
+        m_thread.join();
+    }
+
+    if (0 <= m_stopEventFd)
+        ::close(m_stopEventFd);
+
+    if (0 <= m_inotifyFd)
+        ::close(m_inotifyFd);
+
+    m_stopEventFd = m_inotifyFd = -1;
+}
+
+void
+DirectoryWatcher::watchSubtree(TPathId pathId)
+{
+    if (0 > m_inotifyFd)
+        return;
+
+    {
+        std::scoped_lock lock_(m_sync);
+        m_watchedRoots.insert(pathId);
+    }
+
+    auto pPathTable = PathTable::instance();
+    const auto& subtree = DirectoryStore::instance()->getListedSubtree(pathId);
+
+    for (auto iter = subtree.cbegin(); iter != subtree.cend(); ++iter)
+    {
+        {
+            std::scoped_lock lock_(m_sync);
+            if (m_watchDescriptors.find(*iter) != m_watchDescriptors.end())
+                continue;
+        }
+
+        const QString& dirPath = pPathTable->path(*iter);
+
+        // Watched from now on, changes made after the directory was listed are not reported
+        int err = addWatch(*iter, dirPath);
+        if (0 == err)
+        {
+            if (hasChangedSinceListed(*iter, dirPath))
+                markStale(*iter);
+
+            continue;
+        }
+
+        markStale(*iter);
+
+        if (ENOSPC == err || ENOMEM == err)
+        {
+            qWarning() << "Watch limit is reached, unwatched directories are marked stale";
+
+            // None of the rest can be watched either
+            for (++iter; iter != subtree.cend(); ++iter)
+            {
+                if (DirectoryStore::instance()->markStale(*iter))
+                    notifyDirectory(*iter);
+            }
+
+            break;
+        }
+    }
+}
+
+int
+DirectoryWatcher::addWatch(TPathId pathId, const QString& unifiedPath)
+{
+    const QByteArray& encodedPath = QFile::encodeName(unifiedPath);
+
+    int wd = ::inotify_add_watch(m_inotifyFd, encodedPath.constData(),
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+        IN_DELETE_SELF | IN_MOVE_SELF |
+        IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK);
+    if (0 > wd)
+        return errno;
+
+    std::scoped_lock lock_(m_sync);
+    m_watchedDirs[wd] = pathId;
+    m_watchDescriptors[pathId] = wd;
+
+    return 0;
+}
+
+bool
+DirectoryWatcher::hasChangedSinceListed(TPathId pathId, const QString& unifiedPath)
+{
+    DirectoryListing listing;
+    if (!DirectoryStore::instance()->tryGetDirectoryListing(pathId, listing) || !listing.stamp.has_value())
+        return true;
+
+    try
+    {
+        return !(m_pReader->readDirectoryStamp(unifiedPath) == listing.stamp.value());
+    }
+    catch (const std::exception&)
+    {
+        // Removed meanwhile
+        return true;
+    }
+}
+
+void
+DirectoryWatcher::removeSubtreeWatches(TPathId pathId)
+{
+    const auto& subtree = DirectoryStore::instance()->getListedSubtree(pathId);
+
+    std::scoped_lock lock_(m_sync);
+
+    for (auto id : subtree)
+    {
+        auto iter = m_watchDescriptors.find(id);
+        if (iter == m_watchDescriptors.end())
+            continue;
+
+        // IN_IGNORED for the descriptor is skipped then
+        ::inotify_rm_watch(m_inotifyFd, iter->second);
+
+        m_watchedDirs.erase(iter->second);
+        m_watchDescriptors.erase(iter);
+    }
+
+    m_watchedRoots.erase(pathId);
+}
+
+void
+DirectoryWatcher::watcher()
+{
+    KDBG_CURRENT_THREAD_NAME(L"DirectoryWatcher::watcher");
+
+    try
+    {
+        while (true)
+        {
+            pollfd fds[2] = {
+                { .fd = m_inotifyFd, .events = POLLIN, .revents = 0 },
+                { .fd = m_stopEventFd, .events = POLLIN, .revents = 0 },
+            };
+
+            int res = ::poll(fds, 2, getRefreshTimeout());
+            if (0 > res)
+            {
+                if (EINTR == errno)
+                    continue;
+
+                throw std::system_error(errno, std::generic_category(), "poll");
+            }
+
+            if (fds[1].revents & POLLIN)
+                break;
+
+            if (fds[0].revents & POLLIN)
+                readEvents();
+
+            if (!m_changedDirs.empty() && 0 == getRefreshTimeout())
+                refreshChangedDirectories();
+        }
+    }
+    catch (const std::exception& x)
+    {
+        qCritical() << "ERROR: " << x.what() << endl;
+    }
+}
+
+int
+DirectoryWatcher::getRefreshTimeout() const
+{
+    using namespace std::chrono;
+
+    if (m_changedDirs.empty())
+        return -1;
+
+    const auto now = steady_clock::now();
+    const auto refreshTime = std::min(
+        m_lastChangeTime + milliseconds(WATCH_SETTLE_TIME_MS),
+        m_firstChangeTime + milliseconds(WATCH_MAX_DELAY_MS));
+
+    if (refreshTime <= now)
+        return 0;
+
+    // Round up, otherwise poll() returns a bit too early
+    return static_cast<int>(duration_cast<milliseconds>(refreshTime - now).count()) + 1;
+}
+
+void
+DirectoryWatcher::readEvents()
+{
+    alignas(inotify_event) char buffer[WATCH_EVENT_BUFFER_SIZE];
+
+    auto pPathTable = PathTable::instance();
+
+    while (true)
+    {
+        ssize_t bytesRead = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (0 > bytesRead)
+        {
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+                break;
+            if (EINTR == errno)
+                continue;
+
+            throw std::system_error(errno, std::generic_category(), "inotify read");
+        }
+
+        for (ssize_t pos = 0; pos < bytesRead;)
+        {
+            const auto* pEvent = reinterpret_cast<const inotify_event*>(buffer + pos);
+            pos += sizeof(inotify_event) + pEvent->len;
+
+            // Events are lost, nothing can be trusted anymore
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+                qWarning() << "inotify event queue overflow, watched directories are marked stale";
+
+                std::vector<TPathId> roots;
+                {
+                    std::scoped_lock lock_(m_sync);
+                    roots.assign(m_watchedRoots.cbegin(), m_watchedRoots.cend());
+                }
+
+                for (auto rootId : roots)
+                    markStale(rootId);
+
+                continue;
+            }
+
+            TPathId pathId = InvalidPathId;
+            {
+                std::scoped_lock lock_(m_sync);
+
+                auto iter = m_watchedDirs.find(pEvent->wd);
+                if (iter == m_watchedDirs.end())
+                    continue;
+
+                pathId = iter->second;
+
+                if (pEvent->mask & IN_IGNORED)
+                {
+                    m_watchDescriptors.erase(pathId);
+                    m_watchedDirs.erase(iter);
+                    continue;
+                }
+            }
+
+            // The directory itself is removed or moved, the parent has to be re-listed
+            if (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                bool isRoot = false;
+                {
+                    std::scoped_lock lock_(m_sync);
+                    isRoot = m_watchedRoots.find(pathId) != m_watchedRoots.end();
+                }
+
+                if (isRoot)
+                    markStale(pathId);
+
+                pathId = pPathTable->parent(pathId);
+                if (InvalidPathId == pathId)
+                    continue;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (m_changedDirs.empty())
+                m_firstChangeTime = now;
+            m_lastChangeTime = now;
+
+            m_changedDirs.insert(pathId);
+        }
+    }
+}
+
+void
+DirectoryWatcher::refreshChangedDirectories()
+{
+    std::unordered_set<TPathId> changedDirs;
+    changedDirs.swap(m_changedDirs);
+
+    for (auto pathId : changedDirs)
+    {
+        try
+        {
+            refreshDirectory(pathId);
+        }
+        catch (const std::exception& x)
+        {
+            qCritical() << "ERROR: " << x.what() << endl;
+
+            markStale(pathId);
+        }
+    }
+}
+
+void
+DirectoryWatcher::refreshDirectory(TPathId pathId)
+{
+    auto pStore = DirectoryStore::instance();
+    auto pPathTable = PathTable::instance();
+
+    // Directories which were not listed are not tracked
+    DirectoryListing oldListing;
+    if (!pStore->tryGetDirectoryListing(pathId, oldListing))
+        return;
+
+    const QString& dirPath = pPathTable->path(pathId);
+
+    // The stamp is not kept, since the directory has just changed
+    ListingCollector collector(pathId);
+    try
+    {
+        m_pReader->readDirectory(dirPath, collector);
+    }
+    catch (const std::exception& x)
+    {
+        // Removed meanwhile, handled when its parent is re-listed
+        qCDebug(lcDiagnostics) << "Cannot re-list" << dirPath << ":" << x.what();
+        return;
+    }
+
+    DirectoryListing& newListing = collector.listing;
+
+    // Subdirectory changes
+    auto oldSubdirs = oldListing.subdirectories;
+    auto newSubdirs = newListing.subdirectories;
+    std::sort(oldSubdirs.begin(), oldSubdirs.end());
+    std::sort(newSubdirs.begin(), newSubdirs.end());
+
+    std::vector<TPathId> removedSubdirs, addedSubdirs;
+    std::set_difference(oldSubdirs.cbegin(), oldSubdirs.cend(), newSubdirs.cbegin(), newSubdirs.cend(),
+        std::back_inserter(removedSubdirs));
+    std::set_difference(newSubdirs.cbegin(), newSubdirs.cend(), oldSubdirs.cbegin(), oldSubdirs.cend(),
+        std::back_inserter(addedSubdirs));
+
+    // Own files are replaced as a whole
+    DirectoryStats removedStats = oldListing.ownStats;
+    TMimeDetailsList removedMimeSizes = oldListing.ownMimeSizes;
+
+    DirectoryStats addedStats = newListing.ownStats;
+    TMimeDetailsList addedMimeSizes = newListing.ownMimeSizes;
+
+    for (auto subdirId : removedSubdirs)
+    {
+        DirectoryDetails subdirDetails;
+        if (pStore->tryGetDirectory(subdirId, true, subdirDetails) &&
+            DirectoryProcessingStatus::Ready == subdirDetails.status)
+        {
+            removedStats.addStats(subdirDetails);
+
+            if (nullptr != subdirDetails.mimeDetailsList)
+                removedMimeSizes.addMimeDetails(*subdirDetails.mimeDetailsList);
+        }
+
+        removeSubtreeWatches(subdirId);
+        pStore->removeDirectorySubtree(subdirId);
+    }
+
+    for (auto subdirId : addedSubdirs)
+    {
+        DirectoryStats subdirStats;
+        TMimeDetailsList subdirMimeSizes;
+
+        const QString& subdirPath = getUnifiedChildPath(dirPath, pPathTable->name(subdirId));
+        if (scanNewSubtree(subdirId, subdirPath, subdirStats, subdirMimeSizes))
+        {
+            addedStats.addStats(subdirStats);
+            addedMimeSizes.addMimeDetails(subdirMimeSizes);
+        }
+    }
+
+    pStore->upsertDirectoryListing(pathId, std::move(newListing));
+
+    // Propagate to the directory itself and its ancestors
+    for (auto id = pathId; InvalidPathId != id; id = pPathTable->parent(id))
+    {
+        DirectoryDetails dirDetails;
+        if (!pStore->adjustReadyDirectory(id, removedStats, removedMimeSizes, addedStats, addedMimeSizes, dirDetails))
+            break;
+
+        m_notify(id, pPathTable->path(id), dirDetails);
+    }
+}
+
+bool
+DirectoryWatcher::scanNewSubtree(
+    TPathId pathId,
+    const QString& unifiedPath,
+    DirectoryStats& stats,
+    TMimeDetailsList& mimeSizes)
+{
+    auto pStore = DirectoryStore::instance();
+    auto pPathTable = PathTable::instance();
+
+    DirectoryDetails dirDetails;
+
+    if (!DirectoryScanSwitch::instance()->isEnabled(pathId))
+    {
+        dirDetails.status = DirectoryProcessingStatus::Skipped;
+
+        pStore->upsertDirectory(pathId, dirDetails, true);
+        m_notify(pathId, unifiedPath, dirDetails);
+
+        return false;
+    }
+
+    // Watch before listing, so that no change is missed
+    bool watched = 0 == addWatch(pathId, unifiedPath);
+
+    ListingCollector collector(pathId);
+    try
+    {
+        m_pReader->readDirectory(unifiedPath, collector);
+    }
+    catch (const std::exception& x)
+    {
+        qCritical() << "ERROR: " << x.what() << endl;
+
+        dirDetails.status = DirectoryProcessingStatus::Error;
+
+        pStore->upsertDirectory(pathId, dirDetails, true);
+        m_notify(pathId, unifiedPath, dirDetails);
+
+        return false;
+    }
+
+    stats = collector.listing.ownStats;
+    mimeSizes = collector.listing.ownMimeSizes;
+
+    for (auto subdirId : collector.listing.subdirectories)
+    {
+        DirectoryStats subdirStats;
+        TMimeDetailsList subdirMimeSizes;
+
+        const QString& subdirPath = getUnifiedChildPath(unifiedPath, pPathTable->name(subdirId));
+        if (scanNewSubtree(subdirId, subdirPath, subdirStats, subdirMimeSizes))
+        {
+            stats.addStats(subdirStats);
+            mimeSizes.addMimeDetails(subdirMimeSizes);
+        }
+    }
+
+    pStore->upsertDirectoryListing(pathId, std::move(collector.listing));
+
+    dirDetails.status = DirectoryProcessingStatus::Ready;
+    dirDetails.DirectoryStats::assignStats(stats);
+    dirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(mimeSizes);
+
+    pStore->upsertDirectory(pathId, dirDetails, true);
+    m_notify(pathId, unifiedPath, dirDetails);
+
+    if (!watched)
+        markStale(pathId);
+
+    return true;
+}
+
+#else // __linux__
+
+DirectoryWatcher::DirectoryWatcher(std::unique_ptr<IDirectoryReader> pReader, TNotifyCallback notify)
+: m_pReader(std::move(pReader)),
+  m_notify(std::move(notify))
+{
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+}
+
+void
+DirectoryWatcher::fini()
+{
+}
+
+void
+DirectoryWatcher::watchSubtree(TPathId pathId)
+{
+}
+
+#endif // __linux__
+
+void
+DirectoryWatcher::markStale(TPathId pathId)
+{
+    auto pStore = DirectoryStore::instance();
+    auto pPathTable = PathTable::instance();
+
+    for (auto id : pStore->markSubtreeStale(pathId))
+        notifyDirectory(id);
+
+    // Totals of the ancestors include the subtree
+    for (auto id = pPathTable->parent(pathId);
+         InvalidPathId != id && pStore->markStale(id);
+         id = pPathTable->parent(id))
+    {
+        notifyDirectory(id);
+    }
+}
+
+void
+DirectoryWatcher::notifyDirectory(TPathId pathId)
+{
+    DirectoryDetails dirDetails;
+    if (DirectoryStore::instance()->tryGetDirectory(pathId, false, dirDetails))
+        m_notify(pathId, PathTable::instance()->path(pathId), dirDetails);
+}
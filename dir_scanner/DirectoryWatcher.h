@@ -0,0 +1,104 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <QString>
+
+#include "IDirectoryReader.h"
+#include "model/DirectoryDetails.h"
+#include "model/PathTable.h"
+
+// Keeps scanned subtrees up to date (live update mode).
+// Directories are watched with inotify. A change within a directory causes re-listing
+//	of just this directory, the difference is applied to the directory and its Ready
+//	ancestors in the data store. New subdirectories are scanned and watched,
+//	removed ones are forgotten.
+// If a directory cannot be watched (e.g. fs.inotify.max_user_watches is exhausted)
+//	or events are lost, the affected directories are marked Stale instead.
+// Linux only, elsewhere watchSubtree() does nothing.
+class DirectoryWatcher
+{
+public:
+	typedef std::function<void(TPathId pathId, const QString& unifiedPath, const DirectoryDetails& dirDetails)> TNotifyCallback;
+
+	DirectoryWatcher(std::unique_ptr<IDirectoryReader> pReader, TNotifyCallback notify);
+	~DirectoryWatcher();
+
+	// Call before exiting from the program for the sake of graceful watcher thread completion
+	void fini();
+
+	// Starts watching a scanned subtree (directories known from directory listings).
+	// Directories changed since they were listed (i.e. while the subtree was being scanned)
+	//	are marked Stale, since their changes raised no events.
+	void watchSubtree(TPathId pathId);
+
+private:
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	// Used by the watcher thread, and by watchSubtree() for stamps only (readers are thread-safe)
+	std::unique_ptr<IDirectoryReader> m_pReader;
+
+	TNotifyCallback m_notify;
+
+	int m_inotifyFd = -1;
+	int m_stopEventFd = -1;
+
+	std::thread m_thread;
+
+	std::mutex m_sync;
+
+	std::unordered_map<
+		int,		// Watch descriptor
+		TPathId
+	> m_watchedDirs;
+	std::unordered_map<TPathId, int> m_watchDescriptors;
+
+	// Subtrees passed to watchSubtree()
+	std::unordered_set<TPathId> m_watchedRoots;
+
+	// Changed directories waiting for the events to settle down (watcher thread only)
+	std::unordered_set<TPathId> m_changedDirs;
+	std::chrono::steady_clock::time_point m_firstChangeTime;
+	std::chrono::steady_clock::time_point m_lastChangeTime;
+
+	void watcher();
+
+	// Returns milliseconds to wait for more events before refreshing changed directories
+	int getRefreshTimeout() const;
+
+	void readEvents();
+	void refreshChangedDirectories();
+
+	// Returns errno in case of failure
+	int addWatch(TPathId pathId, const QString& unifiedPath);
+
+	// Compares the current stamp of a directory with the one taken when it was listed.
+	//	A directory listed without a settled stamp is considered changed.
+	bool hasChangedSinceListed(TPathId pathId, const QString& unifiedPath);
+	void removeSubtreeWatches(TPathId pathId);
+
+	// Re-lists a changed directory and applies the difference
+	void refreshDirectory(TPathId pathId);
+
+	// Scans and watches a new subdirectory, returns false if it is not Ready
+	bool scanNewSubtree(
+		TPathId pathId,
+		const QString& unifiedPath,
+		DirectoryStats& stats,
+		TMimeDetailsList& mimeSizes);
+
+	// Marks the subtree and its ancestors Stale
+	void markStale(TPathId pathId);
+
+	void notifyDirectory(TPathId pathId);
+};
+
+#endif // DIRECTORYWATCHER_H
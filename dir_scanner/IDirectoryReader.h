@@ -0,0 +1,41 @@
+#ifndef IDIRECTORYREADER_H
+#define IDIRECTORYREADER_H
+
+#include <QString>
+
+#include "model/ExtensionTable.h"
+#include "model/DirectoryListing.h"
+
+// Receives entries of a directory being read
+struct IDirectoryEntrySink
+{
+	virtual ~IDirectoryEntrySink() = default;
+
+	// Both return false in order to stop reading (e.g. in case of cancellation)
+
+	// name - subdirectory name (without path)
+	virtual bool onSubdirectory(const QString& name) = 0;
+
+	// extensionId - interned file extension without leading dot
+	virtual bool onRegularFile(TExtensionId extensionId, unsigned long long fileSize) = 0;
+};
+
+// Directory listing backend
+struct IDirectoryReader
+{
+	virtual ~IDirectoryReader() = default;
+
+	// Backend name for diagnostics
+	virtual const char* name() const noexcept = 0;
+
+	// Reads immediate entries of a directory, symbolic links are skipped.
+	// Returns false if reading is stopped by the sink.
+	// Throws in case the directory cannot be read.
+	virtual bool readDirectory(const QString& unifiedPath, IDirectoryEntrySink& sink) = 0;
+
+	// Reads the directory's own metadata (a single stat call).
+	// Throws in case the directory cannot be stat-ed.
+	virtual DirectoryStamp readDirectoryStamp(const QString& unifiedPath) = 0;
+};
+
+#endif // IDIRECTORYREADER_H
@@ -3,15 +3,28 @@
 
 #include "KDirectoryInfo.h"
 #include "KMimeSizesInfo.h"
+#include "KScanUpdateBatch.h"
 
 // Data scanning event subscribers/sinks
 struct IDirectoryScannerEventSink
 {
 	virtual ~IDirectoryScannerEventSink() = default;
 
-	virtual void onUpdateDirectoryInfo(KDirectoryInfoPtr pInfo) = 0;
+	// Called once per notification interval, not under any scanner lock.
+	// The batch is consumed when the sink releases it: until then no new batches are
+	//	delivered to the sink, updates are coalesced (the latest per directory) instead.
+	virtual void onUpdateBatch(KScanUpdateBatchPtr pBatch)
+	{
+		for (const auto& pInfo : pBatch->dirInfos)
+			onUpdateDirectoryInfo(pInfo);
 
-	virtual void onUpdateMimeSizes(KMimeSizesInfoPtr pInfo) = 0;
+		for (const auto& pInfo : pBatch->mimeSizesInfos)
+			onUpdateMimeSizes(pInfo);
+	}
+
+	virtual void onUpdateDirectoryInfo(KDirectoryInfoPtr pInfo) {}
+
+	virtual void onUpdateMimeSizes(KMimeSizesInfoPtr pInfo) {}
 
 	virtual void onWorkerException(std::exception_ptr&& pEx) = 0;
 };
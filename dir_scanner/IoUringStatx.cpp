@@ -0,0 +1,264 @@
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <QDebug>
+
+#include "IoUringStatx.h"
+
+// Ring size, number of statx requests in flight per thread
+#define IO_URING_STATX_ENTRIES 256
+
+namespace
+{
+    // Cleared as soon as io_uring turns out to be unusable
+    std::atomic<bool> s_ioUringAvailable = true;
+
+    inline unsigned loadAcquire(const unsigned* p)
+    {
+        return std::atomic_ref<unsigned>(*const_cast<unsigned*>(p)).load(std::memory_order_acquire);
+    }
+
+    inline void storeRelease(unsigned* p, unsigned value)
+    {
+        std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+    }
+}
+
+IoUringStatx*
+IoUringStatx::forCurrentThread()
+{
+    if (!s_ioUringAvailable)
+        return nullptr;
+
+    thread_local std::unique_ptr<IoUringStatx> s_pRing;
+    thread_local bool s_initialized = false;
+
+    if (!s_initialized)
+    {
+        s_initialized = true;
+
+        std::unique_ptr<IoUringStatx> pRing(new IoUringStatx());
+        if (pRing->init(IO_URING_STATX_ENTRIES))
+        {
+            s_pRing = std::move(pRing);
+        }
+        else
+        {
+            qWarning() << "io_uring statx is not available, falling back to synchronous statx";
+            s_ioUringAvailable = false;
+        }
+    }
+
+    return s_pRing.get();
+}
+
+IoUringStatx::~IoUringStatx()
+{
+    if (m_sqes)
+        ::munmap(m_sqes, m_sqesSize);
+
+    if (m_cqRing && m_cqRing != m_sqRing)
+        ::munmap(m_cqRing, m_cqRingSize);
+
+    if (m_sqRing)
+        ::munmap(m_sqRing, m_sqRingSize);
+
+    if (0 <= m_ringFd)
+        ::close(m_ringFd);
+}
+
+bool
+IoUringStatx::init(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    m_ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (0 > m_ringFd)
+        return false;
+
+    m_sqEntries = params.sq_entries;
+
+    //
+    // Map rings
+    //
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    const bool singleMmap = 0 != (params.features & IORING_FEAT_SINGLE_MMAP);
+    if (singleMmap)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        m_ringFd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == m_sqRing)
+    {
+        m_sqRing = nullptr;
+        return false;
+    }
+
+    if (singleMmap)
+    {
+        m_cqRing = m_sqRing;
+    }
+    else
+    {
+        m_cqRing = ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_ringFd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == m_cqRing)
+        {
+            m_cqRing = nullptr;
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        m_ringFd, IORING_OFF_SQES);
+    if (MAP_FAILED == m_sqes)
+    {
+        m_sqes = nullptr;
+        return false;
+    }
+
+    auto* sqRing = static_cast<char*>(m_sqRing);
+    m_sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+
+    auto* cqRing = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+    m_cqes = cqRing + params.cq_off.cqes;
+
+    //
+    // Probe: kernels before 5.6 accept the ring but fail IORING_OP_STATX with -EINVAL
+    //
+
+    struct statx stx;
+    prepareStatx(AT_FDCWD, "/", &stx, 0);
+
+    int probeRes = -EINVAL;
+    try
+    {
+        unsigned completed = 0;
+        for (unsigned toSubmit = 1; 0 == completed; )
+        {
+            toSubmit -= enter(toSubmit, 1);
+
+            completed = reapCompletions([&](const io_uring_cqe& cqe) {
+                probeRes = cqe.res;
+            });
+        }
+    }
+    catch (const std::system_error&)
+    {
+        return false;
+    }
+
+    return 0 == probeRes;
+}
+
+void
+IoUringStatx::prepareStatx(int dirFd, const char* name, struct statx* pResult, unsigned long long userData)
+{
+    const unsigned tail = *m_sqTail;
+    const unsigned index = tail & *m_sqMask;
+
+    auto* sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<unsigned long long>(name);
+    sqe->len = STATX_TYPE | STATX_SIZE;
+    sqe->off = reinterpret_cast<unsigned long long>(pResult);
+    sqe->statx_flags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+    sqe->user_data = userData;
+
+    m_sqArray[index] = index;
+
+    // Make the entry visible to the kernel
+    storeRelease(m_sqTail, tail + 1);
+}
+
+unsigned
+IoUringStatx::enter(unsigned toSubmit, unsigned minComplete)
+{
+    while (true)
+    {
+        long res = ::syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete,
+            0 < minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+        if (0 <= res)
+            return static_cast<unsigned>(res);
+
+        if (EINTR != errno && EAGAIN != errno && EBUSY != errno)
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+}
+
+template <class TFunc>
+unsigned
+IoUringStatx::reapCompletions(TFunc&& onCqe)
+{
+    unsigned head = *m_cqHead;
+    const unsigned tail = loadAcquire(m_cqTail);
+
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count)
+    {
+        const auto& cqe = static_cast<const io_uring_cqe*>(m_cqes)[head & *m_cqMask];
+        onCqe(cqe);
+    }
+
+    // Release completion slots
+    storeRelease(m_cqHead, head);
+
+    return count;
+}
+
+bool
+IoUringStatx::statBatch(int dirFd, const std::vector<const char*>& names, const TCompletionCallback& onComplete)
+{
+    const size_t count = names.size();
+    if (m_results.size() < count)
+        m_results.resize(count);
+
+    size_t next = 0;
+    unsigned inFlight = 0;
+    unsigned notSubmitted = 0;
+    bool stopped = false;
+
+    while ((!stopped && next < count) || 0 < inFlight)
+    {
+        // Fill the submission queue
+        for (; !stopped && next < count && inFlight < m_sqEntries; ++next, ++inFlight, ++notSubmitted)
+            prepareStatx(dirFd, names[next], &m_results[next], next);
+
+        notSubmitted -= enter(notSubmitted, 0 < inFlight ? 1 : 0);
+
+        inFlight -= reapCompletions([&](const io_uring_cqe& cqe) {
+            const size_t index = static_cast<size_t>(cqe.user_data);
+
+            // Still need to drain the rest of requests in flight after stopping
+            if (!stopped && !onComplete(index, m_results[index], cqe.res))
+                stopped = true;
+        });
+    }
+
+    return !stopped;
+}
+
+#endif // __linux__
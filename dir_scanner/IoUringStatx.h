@@ -0,0 +1,78 @@
+#ifndef IOURINGSTATX_H
+#define IOURINGSTATX_H
+
+#ifdef __linux__
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/stat.h>
+
+// Minimal io_uring (raw syscalls, no liburing) which only submits batches of statx requests.
+// A ring is owned by a single thread.
+class IoUringStatx
+{
+public:
+	~IoUringStatx();
+
+	// Returns a ring of the calling thread or nullptr if io_uring is unavailable
+	//	(old kernel, no IORING_OP_STATX support, blocked by seccomp, etc.).
+	// Once unavailable, it is never probed again.
+	static IoUringStatx* forCurrentThread();
+
+	// Completion callback: entry index within the batch, statx result, 0 or -errno.
+	// Returns false in order to stop submitting the rest of the batch.
+	typedef std::function<bool(size_t index, const struct statx& stx, int res)> TCompletionCallback;
+
+	// Submits statx (type and size) for names relative to dirFd and reaps completions
+	//	in the order they arrive. Returns after all submitted requests are complete.
+	// Returns false if stopped by the callback.
+	// Throws in case of an io_uring failure.
+	bool statBatch(int dirFd, const std::vector<const char*>& names, const TCompletionCallback& onComplete);
+
+private:
+	IoUringStatx() = default;
+	IoUringStatx(const IoUringStatx&) = delete;
+	IoUringStatx& operator=(const IoUringStatx&) = delete;
+
+	// Returns false if io_uring cannot be used
+	bool init(unsigned entries);
+
+	int m_ringFd = -1;
+
+	void* m_sqRing = nullptr;
+	size_t m_sqRingSize = 0;
+	void* m_cqRing = nullptr;
+	size_t m_cqRingSize = 0;
+	void* m_sqes = nullptr;
+	size_t m_sqesSize = 0;
+
+	unsigned m_sqEntries = 0;
+
+	// Ring pointers
+	unsigned* m_sqTail = nullptr;
+	unsigned* m_sqMask = nullptr;
+	unsigned* m_sqArray = nullptr;
+	unsigned* m_cqHead = nullptr;
+	unsigned* m_cqTail = nullptr;
+	unsigned* m_cqMask = nullptr;
+	void* m_cqes = nullptr;
+
+	// statx output buffers, one per batch entry
+	std::vector<struct statx> m_results;
+
+	void prepareStatx(int dirFd, const char* name, struct statx* pResult, unsigned long long userData);
+
+	// Submits toSubmit prepared entries and waits for at least minComplete completions.
+	// Returns number of consumed entries.
+	unsigned enter(unsigned toSubmit, unsigned minComplete);
+
+	// Calls onCqe for every available completion
+	template <class TFunc>
+	unsigned reapCompletions(TFunc&& onCqe);
+};
+
+#endif // __linux__
+
+#endif // IOURINGSTATX_H
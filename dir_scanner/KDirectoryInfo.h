@@ -5,10 +5,14 @@
 #include <optional>
 #include <QString>
 #include "model/DirectoryStats.h"
+#include "model/PathTable.h"
 
 // Directory data without a directory path
 struct KDirectoryData : DirectoryStatsWithStatus
 {
+	// Files of the directory itself (not recursive)
+	std::optional<unsigned long> ownFileCount;
+	std::optional<unsigned long long> ownSize;
 };
 
 // Directory tree item
@@ -16,6 +20,9 @@ struct KDirectoryInfo : KDirectoryData
 {
 	// Unified directory path
 	QString fullPath;
+
+	// Interned fullPath
+	TPathId pathId = InvalidPathId;
 };
 
 typedef std::shared_ptr<KDirectoryInfo> KDirectoryInfoPtr;
@@ -0,0 +1,21 @@
+#ifndef KSCANUPDATEBATCH_H
+#define KSCANUPDATEBATCH_H
+
+#include <memory>
+#include <vector>
+#include "KDirectoryInfo.h"
+#include "KMimeSizesInfo.h"
+
+// Directory and MIME type updates collected during a notification interval.
+// At most one update per directory (the latest one), immutable once delivered.
+struct KScanUpdateBatch
+{
+	std::vector<KDirectoryInfoPtr> dirInfos;
+	std::vector<KMimeSizesInfoPtr> mimeSizesInfos;
+};
+
+typedef std::shared_ptr<const KScanUpdateBatch> KScanUpdateBatchPtr;
+
+Q_DECLARE_METATYPE(KScanUpdateBatchPtr)
+
+#endif // KSCANUPDATEBATCH_H
@@ -0,0 +1,257 @@
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <QFile>
+
+#include "LinuxDirectoryReader.h"
+#include "IoUringStatx.h"
+
+// getdents64 buffer size, big enough to read most directories with a few syscalls
+#define GETDENTS_BUFFER_SIZE (64 * 1024)
+
+namespace
+{
+    // Kernel directory entry as returned by getdents64
+    struct linux_dirent64
+    {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    // Closes fd on scope exit
+    struct ScopedFd
+    {
+        int fd;
+        ~ScopedFd() { if (0 <= fd) ::close(fd); }
+    };
+
+    enum class EntryType
+    {
+        Directory,
+        RegularFile,
+        Other,      // Symbolic links, devices, etc.
+        Vanished,   // Removed while reading
+    };
+
+    // res - 0 or -errno
+    EntryType classifyEntry(int res, mode_t mode, const char* name)
+    {
+        if (0 != res)
+        {
+            if (-ENOENT == res)
+                return EntryType::Vanished;
+
+            throw std::system_error(-res, std::generic_category(), name);
+        }
+
+        if (S_ISDIR(mode))
+            return EntryType::Directory;
+        else if (S_ISREG(mode))
+            return EntryType::RegularFile;
+
+        return EntryType::Other;
+    }
+
+    // Returns file type and size (for regular files)
+    EntryType statEntry(int dirFd, const char* name, unsigned long long& fileSize)
+    {
+        int res;
+        mode_t mode;
+
+#ifdef STATX_SIZE
+        struct statx stx;
+        res = ::statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE | STATX_SIZE, &stx);
+        mode = stx.stx_mode;
+        fileSize = stx.stx_size;
+#else
+        struct stat st;
+        res = ::fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT);
+        mode = st.st_mode;
+        fileSize = st.st_size;
+#endif
+
+        return classifyEntry(0 == res ? 0 : -errno, mode, name);
+    }
+
+    // Same as std::filesystem::path::extension() but without leading dot
+    std::string_view getExtension(const char* name, size_t nameLen)
+    {
+        const char* dot = static_cast<const char*>(::memrchr(name, '.', nameLen));
+
+        // ".bashrc" has no extension
+        if (!dot || dot == name)
+            return std::string_view();
+
+        return std::string_view(dot + 1, name + nameLen - dot - 1);
+    }
+}
+
+LinuxDirectoryReader::LinuxDirectoryReader(bool useIoUring)
+: m_useIoUring(useIoUring)
+{
+}
+
+const char*
+LinuxDirectoryReader::name() const noexcept
+{
+    return m_useIoUring ? "getdents64+io_uring" : "getdents64";
+}
+
+bool
+LinuxDirectoryReader::readDirectory(const QString& unifiedPath, IDirectoryEntrySink& sink)
+{
+    const QByteArray& encodedPath = QFile::encodeName(unifiedPath);
+
+    ScopedFd dirFd{ ::openat(AT_FDCWD, encodedPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+    if (0 > dirFd.fd)
+        throw std::system_error(errno, std::generic_category(), encodedPath.constData());
+
+    // Ring of this (worker) thread if statx batching is requested and available
+    IoUringStatx* pRing = nullptr;
+#ifdef STATX_SIZE
+    if (m_useIoUring)
+        pRing = IoUringStatx::forCurrentThread();
+#endif
+
+    thread_local std::unique_ptr<char[]> buffer(new char[GETDENTS_BUFFER_SIZE]);
+
+    // Names (pointing into the buffer) to be stat-ed in a batch
+    thread_local std::vector<const char*> statNames;
+
+    auto reportEntry = [&](EntryType entryType, const char* name, unsigned long long fileSize) {
+        if (EntryType::Directory == entryType)
+            return sink.onSubdirectory(QFile::decodeName(name));
+        else if (EntryType::RegularFile == entryType)
+            return sink.onRegularFile(
+                ExtensionTable::instance()->internLocal8Bit(getExtension(name, ::strlen(name))), fileSize);
+
+        return true;
+    };
+
+    while (true)
+    {
+        long bytesRead = ::syscall(SYS_getdents64, dirFd.fd, buffer.get(), GETDENTS_BUFFER_SIZE);
+        if (0 > bytesRead)
+            throw std::system_error(errno, std::generic_category(), encodedPath.constData());
+
+        if (0 == bytesRead)
+            break;
+
+        statNames.clear();
+
+        for (long offset = 0; offset < bytesRead;)
+        {
+            const auto* entry = reinterpret_cast<const linux_dirent64*>(buffer.get() + offset);
+            offset += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if ('.' == name[0] && ('\0' == name[1] || ('.' == name[1] && '\0' == name[2])))
+                continue;
+
+            EntryType entryType = EntryType::Other;
+            unsigned long long fileSize = 0;
+
+            switch (entry->d_type)
+            {
+            case DT_DIR:
+                entryType = EntryType::Directory;
+                break;
+            case DT_REG:        // Size is needed anyway
+            case DT_UNKNOWN:    // File system does not report types (e.g. some network ones)
+                if (pRing)
+                {
+                    statNames.push_back(name);
+                    continue;
+                }
+
+                entryType = statEntry(dirFd.fd, name, fileSize);
+                break;
+            default:
+                break;
+            }
+
+            if (!reportEntry(entryType, name, fileSize))
+                return false;
+        }
+
+#ifdef STATX_SIZE
+        // Stat the whole buffer worth of files at once
+        if (pRing && !statNames.empty())
+        {
+            // Errors are rethrown only after all the requests in flight are drained
+            std::exception_ptr pError;
+
+            bool res = pRing->statBatch(dirFd.fd, statNames,
+                [&](size_t index, const struct statx& stx, int statRes) {
+                    try
+                    {
+                        const char* name = statNames[index];
+                        EntryType entryType = classifyEntry(statRes, stx.stx_mode, name);
+
+                        return reportEntry(entryType, name, stx.stx_size);
+                    }
+                    catch (...)
+                    {
+                        pError = std::current_exception();
+                        return false;
+                    }
+                });
+
+            if (pError)
+                std::rethrow_exception(pError);
+
+            if (!res)
+                return false;
+        }
+#endif
+    }
+
+    return true;
+}
+
+DirectoryStamp
+LinuxDirectoryReader::readDirectoryStamp(const QString& unifiedPath)
+{
+    const QByteArray& encodedPath = QFile::encodeName(unifiedPath);
+
+    DirectoryStamp stamp;
+
+#ifdef STATX_SIZE
+    struct statx stx;
+    if (0 != ::statx(AT_FDCWD, encodedPath.constData(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                     STATX_MTIME | STATX_CTIME | STATX_INO, &stx))
+        throw std::system_error(errno, std::generic_category(), encodedPath.constData());
+
+    stamp.mtimeNs = stx.stx_mtime.tv_sec * 1000000000LL + stx.stx_mtime.tv_nsec;
+    stamp.ctimeNs = stx.stx_ctime.tv_sec * 1000000000LL + stx.stx_ctime.tv_nsec;
+    stamp.inode = stx.stx_ino;
+    stamp.device = (static_cast<unsigned long long>(stx.stx_dev_major) << 32) | stx.stx_dev_minor;
+#else
+    struct stat st;
+    if (0 != ::lstat(encodedPath.constData(), &st))
+        throw std::system_error(errno, std::generic_category(), encodedPath.constData());
+
+    stamp.mtimeNs = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.ctimeNs = st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+    stamp.inode = st.st_ino;
+    stamp.device = st.st_dev;
+#endif
+
+    return stamp;
+}
+
+#endif // __linux__
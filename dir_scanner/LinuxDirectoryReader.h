@@ -0,0 +1,31 @@
+#ifndef LINUXDIRECTORYREADER_H
+#define LINUXDIRECTORYREADER_H
+
+#ifdef __linux__
+
+#include "IDirectoryReader.h"
+
+// Linux-native directory reader.
+// Reads raw entries with getdents64 from a directory fd and classifies them by d_type,
+//	so that only regular files (and entries of unknown type) cost a stat call,
+//	which is done with statx/fstatat relative to the directory fd.
+// Optionally statx calls for a whole getdents64 buffer are submitted at once via io_uring.
+class LinuxDirectoryReader : public IDirectoryReader
+{
+public:
+	// If io_uring is requested but not available, synchronous statx is used
+	explicit LinuxDirectoryReader(bool useIoUring = false);
+
+	virtual const char* name() const noexcept override;
+
+	virtual bool readDirectory(const QString& unifiedPath, IDirectoryEntrySink& sink) override;
+
+	virtual DirectoryStamp readDirectoryStamp(const QString& unifiedPath) override;
+
+private:
+	const bool m_useIoUring;
+};
+
+#endif // __linux__
+
+#endif // LINUXDIRECTORYREADER_H
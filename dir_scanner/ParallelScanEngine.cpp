@@ -0,0 +1,735 @@
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <QDebug>
+
+#include "config.h"
+
+#include "ParallelScanEngine.h"
+#include "model/DirectoryScanSwitch.h"
+#include "model/DirectoryStore.h"
+#include "utils.h"
+
+// Covers coarse (e.g. 2 seconds on FAT) file system timestamp granularity
+#define SETTLED_STAMP_AGE_NS (3 * 1000000000LL)
+
+// Intermediate results of a directory being scanned are published at most this often,
+//  rather than once per finished subdirectory
+#define INTERMEDIATE_RESULTS_INTERVAL_NS (200 * 1000000LL)
+
+ParallelScanEngine::ParallelScanEngine(
+    unsigned workerCount,
+    std::unique_ptr<IDirectoryReader> pReader,
+    bool stampListings,
+    bool reuseUnchangedListings,
+    TNotifyCallback notify,
+    TCancellationPredicate isCancellationRequested)
+: m_pReader(std::move(pReader)),
+  m_stampListings(stampListings),
+  m_reuseUnchangedListings(stampListings && reuseUnchangedListings),
+  m_notify(std::move(notify)),
+  m_isCancellationRequested(std::move(isCancellationRequested))
+{
+    assert(m_pReader);
+
+    if (0 == workerCount)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (auto& queues : m_queues)
+    {
+        queues.reserve(workerCount);
+        for (unsigned i = 0; i < workerCount; ++i)
+            queues.emplace_back(std::make_unique<WorkStealingQueue<TScanNodePtr>>());
+    }
+
+    // Start threads only after all the queues are created
+    m_workers.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&ParallelScanEngine::worker, this, i);
+}
+
+ParallelScanEngine::~ParallelScanEngine()
+{
+    assert(m_workers.empty());
+}
+
+void
+ParallelScanEngine::fini()
+{
+    {
+        std::scoped_lock lock_(m_sync);
+        m_stopWorkers = true;
+    }
+
+    m_cvWorkAvailable.notify_all();
+
+    for (auto& th : m_workers)
+        th.join();
+
+    m_workers.clear();
+}
+
+unsigned
+ParallelScanEngine::workerCount() const noexcept
+{
+    return static_cast<unsigned>(m_queues[0].size());
+}
+
+ParallelScanEngine::ScanTreeResult
+ParallelScanEngine::scanTree(
+    const QString& unifiedPath,
+    ScanPriority priority,
+    unsigned detachEpoch,
+    DirectoryStats& stats,
+    TMimeDetailsList& mimeSizes)
+{
+    assert(isUnifiedPath(unifiedPath));
+
+    auto pScanRoot = std::make_shared<ScanRoot>();
+    pScanRoot->priority = priority;
+
+    auto pRoot = std::make_shared<ScanNode>();
+    pRoot->fullPath = unifiedPath;
+    pRoot->pathId = PathTable::instance()->intern(unifiedPath);
+    pRoot->pScanRoot = pScanRoot;
+    pRoot->priority = priority;
+    pScanRoot->pNode = pRoot;
+
+    {
+        std::scoped_lock lock_(m_sync);
+
+        if (m_stopWorkers)
+            return ScanTreeResult::Cancelled;
+
+        // Focus has moved on before the scan even started
+        if (ScanPriority::Focused == priority && detachEpoch != m_detachEpoch)
+            return ScanTreeResult::Detached;
+
+        m_activeRoots.push_back(pScanRoot);
+        ++m_unresolvedRootCount;
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // The directory may be being scanned on behalf of another subtree already
+    while (true)
+    {
+        auto pClaimed = tryClaim(pRoot);
+        if (!pClaimed)
+        {
+            pushTask(0, std::move(pRoot));
+            break;
+        }
+
+        if (tryFollow(*pClaimed, pRoot))
+        {
+            if (priority > pClaimed->priority)
+                changePriority(pClaimed, priority);
+
+            pRoot.reset();
+            break;
+        }
+    }
+
+    // Wait for the whole subtree to be resolved
+    std::optional<RootResult> result;
+    {
+        std::unique_lock lock_(m_sync);
+        m_cvRootDone.wait(lock_, [&] { return pScanRoot->result.has_value() || pScanRoot->detached; });
+
+        std::erase(m_activeRoots, pScanRoot);
+        result = std::move(pScanRoot->result);
+    }
+
+    // Allows comparing directory reader backends on the same tree
+    const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+    qCDebug(lcDiagnostics) << (result.has_value() ? "Scanned" : "Detached") << unifiedPath << "in" << elapsedMs << "ms, reader:"
+        << m_pReader->name() << ", workers:" << workerCount();
+
+    if (!result.has_value())
+        return ScanTreeResult::Detached;
+
+    if (result->pError)
+        std::rethrow_exception(result->pError);
+
+    if (DirectoryProcessingStatus::Ready != result->status)
+        return ScanTreeResult::Cancelled;
+
+    stats.assignStats(result->stats);
+    mimeSizes = std::move(result->mimeSizes);
+
+    return ScanTreeResult::Complete;
+}
+
+unsigned
+ParallelScanEngine::getDetachEpoch()
+{
+    std::scoped_lock lock_(m_sync);
+    return m_detachEpoch;
+}
+
+void
+ParallelScanEngine::detachFocusedScans()
+{
+    std::vector<TScanNodePtr> detachedNodes;
+
+    {
+        std::scoped_lock lock_(m_sync);
+        ++m_detachEpoch;
+
+        for (auto& pScanRoot : m_activeRoots)
+        {
+            if (ScanPriority::Focused != pScanRoot->priority || pScanRoot->result.has_value())
+                continue;
+
+            pScanRoot->detached = true;
+            pScanRoot->priority = ScanPriority::Background;
+
+            if (auto pNode = pScanRoot->pNode.lock())
+                detachedNodes.push_back(std::move(pNode));
+        }
+    }
+
+    m_cvRootDone.notify_all();
+
+    // Work done so far is kept, the rest goes on in the background
+    for (const auto& pNode : detachedNodes)
+        changePriority(pNode, ScanPriority::Background);
+}
+
+void
+ParallelScanEngine::pushTask(size_t workerIndex, TScanNodePtr pNode)
+{
+    const auto lane = static_cast<size_t>(pNode->priority.load());
+
+    // Counted before the node can be taken, so that the count never drops below zero.
+    //  A worker woken in between just looks for the node once more.
+    {
+        std::scoped_lock lock_(m_sync);
+        ++m_queuedCount;
+    }
+
+    m_queues[lane][workerIndex]->push(std::move(pNode));
+
+    m_cvWorkAvailable.notify_one();
+}
+
+bool
+ParallelScanEngine::tryTakeTask(size_t workerIndex, TScanNodePtr& pNode)
+{
+    const size_t queueCount = workerCount();
+
+    // The last worker prefers background tasks, so that a focused scan never stalls them
+    ScanPriority lanes[] = { ScanPriority::Focused, ScanPriority::Background };
+    if (1 < queueCount && workerIndex + 1 == queueCount)
+        std::swap(lanes[0], lanes[1]);
+
+    for (auto lane : lanes)
+    {
+        TQueues& queues = m_queues[static_cast<size_t>(lane)];
+
+        bool res = queues[workerIndex]->tryPop(pNode);
+
+        // Steal from the others starting from the next one
+        for (size_t i = 1; !res && i < queueCount; ++i)
+            res = queues[(workerIndex + i) % queueCount]->trySteal(pNode);
+
+        if (res)
+        {
+            // Counted by pushTask() before the node was queued
+            assert(0 < m_queuedCount);
+            --m_queuedCount;
+
+            // Drop the copy of a node which was requeued on a priority change
+            return !pNode->taken.exchange(true);
+        }
+    }
+
+    return false;
+}
+
+ParallelScanEngine::TScanNodePtr
+ParallelScanEngine::tryClaim(const TScanNodePtr& pNode)
+{
+    std::scoped_lock lock_(m_claimsSync);
+
+    auto& pClaimed = m_claims[pNode->pathId];
+    if (auto pExisting = pClaimed.lock(); pExisting && !pExisting->resolved)
+        return pExisting;
+
+    pClaimed = pNode;
+    return nullptr;
+}
+
+void
+ParallelScanEngine::releaseClaim(const ScanNode& node)
+{
+    std::scoped_lock lock_(m_claimsSync);
+
+    auto iter = m_claims.find(node.pathId);
+    if (m_claims.end() != iter && iter->second.lock().get() == &node)
+        m_claims.erase(iter);
+}
+
+bool
+ParallelScanEngine::tryFollow(ScanNode& followed, const TScanNodePtr& pFollower)
+{
+    std::scoped_lock lock_(followed.sync);
+
+    if (followed.resolved)
+        return false;
+
+    followed.followers.push_back(pFollower);
+    return true;
+}
+
+void
+ParallelScanEngine::changePriority(const TScanNodePtr& pNode, ScanPriority priority)
+{
+    ScanPriority prevPriority;
+    std::vector<std::weak_ptr<ScanNode>> children;
+
+    {
+        std::scoped_lock lock_(pNode->sync);
+
+        prevPriority = pNode->priority.exchange(priority);
+        if (prevPriority == priority)
+            return;
+
+        children = pNode->children;
+    }
+
+    // Let a waiting directory be taken from the lane of its new priority.
+    // Demoted ones just remain in the lane they were queued in.
+    if (priority > prevPriority && !pNode->taken && !pNode->resolved)
+        pushTask(0, pNode);
+
+    for (const auto& pWeakChild : children)
+    {
+        if (auto pChild = pWeakChild.lock())
+            changePriority(pChild, priority);
+    }
+}
+
+void
+ParallelScanEngine::worker(size_t workerIndex)
+{
+    KDBG_CURRENT_THREAD_NAME(L"ParallelScanEngine::worker");
+
+    while (true)
+    {
+        {
+            std::unique_lock lock_(m_sync);
+            // Let the scans being waited for finish (get cancelled)
+            const auto isStopped = [&] { return m_stopWorkers && 0 == m_unresolvedRootCount; };
+            m_cvWorkAvailable.wait(lock_, [&] { return isStopped() || 0 < m_queuedCount; });
+
+            if (isStopped())
+                break;
+        }
+
+        TScanNodePtr pNode;
+        if (tryTakeTask(workerIndex, pNode))
+            processNode(workerIndex, pNode);
+    }
+}
+
+class ParallelScanEngine::NodeEntrySink : public IDirectoryEntrySink
+{
+public:
+    NodeEntrySink(ParallelScanEngine& engine, size_t workerIndex, const TScanNodePtr& pNode)
+    : m_engine(engine),
+      m_workerIndex(workerIndex),
+      m_pNode(pNode)
+    {
+    }
+
+    // Own results are collected locally and added to the node when listing is complete.
+    // Files of the directory itself (+ immediate subdirectory count)...
+    DirectoryStats ownStats{ .subdirectoryCount = 0, .totalFileCount = 0, .totalSize = 0 };
+    TMimeDetailsList ownMimeSizes;
+    std::vector<TPathId> subdirectories;
+
+    // ...and subdirectories, which were scanned before
+    DirectoryStats readyStats;
+    TMimeDetailsList readyMimeSizes;
+
+    virtual bool onSubdirectory(const QString& name) override
+    {
+        // No need to canonicalize a child of a unified path, symbolic links are skipped
+        const QString& fullPath = getUnifiedChildPath(m_pNode->fullPath, name);
+        const TPathId pathId = PathTable::instance()->internChild(m_pNode->pathId, name);
+
+        ownStats.subdirectoryCount = ownStats.subdirectoryCount.value() + 1;
+        subdirectories.push_back(pathId);
+
+        return addSubdirectory(pathId, fullPath);
+    }
+
+    // Replays a listing of an unchanged directory. Subdirectories are validated on their own.
+    bool replayListing(const DirectoryListing& listing)
+    {
+        ownStats = listing.ownStats;
+        ownMimeSizes = listing.ownMimeSizes;
+
+        auto pPathTable = PathTable::instance();
+        for (auto pathId : listing.subdirectories)
+        {
+            const QString& fullPath = getUnifiedChildPath(m_pNode->fullPath, pPathTable->name(pathId));
+
+            if (!addSubdirectory(pathId, fullPath))
+                return false;
+        }
+
+        return true;
+    }
+
+    virtual bool onRegularFile(TExtensionId extensionId, unsigned long long fileSize) override
+    {
+        if (isCancellationRequested())
+            return false;
+
+        ownStats.totalSize = ownStats.totalSize.value() + fileSize;
+        ownStats.totalFileCount = ownStats.totalFileCount.value() + 1;
+
+        ownMimeSizes.addMimeDetails(TMimeDetailsList::ALL_MIMETYPE_ID, fileSize, 1);
+        ownMimeSizes.addMimeDetails(extensionId, fileSize, 1);
+
+        return true;
+    }
+
+private:
+    ParallelScanEngine& m_engine;
+    const size_t m_workerIndex;
+    const TScanNodePtr& m_pNode;
+
+    bool addSubdirectory(TPathId pathId, const QString& fullPath)
+    {
+        if (isCancellationRequested())
+            return false;
+
+        // Check if scanned before
+        DirectoryDetails childDetails;
+        if (DirectoryStore::instance()->tryGetDirectory(pathId, true, childDetails) &&
+            (DirectoryProcessingStatus::Ready == childDetails.status ||
+             DirectoryProcessingStatus::Error == childDetails.status))
+        {
+            if (DirectoryProcessingStatus::Ready == childDetails.status)
+            {
+                readyStats.addStats(childDetails);
+
+                if (nullptr != childDetails.mimeDetailsList)
+                    readyMimeSizes.addMimeDetails(*childDetails.mimeDetailsList);
+            }
+
+            return true;
+        }
+
+        // Check if skipped (only after checking if scanned before in order to avoid multiple scans)
+        if (!DirectoryScanSwitch::instance()->isEnabled(pathId))
+        {
+            DirectoryDetails skippedDetails;
+            skippedDetails.status = DirectoryProcessingStatus::Skipped;
+
+            DirectoryStore::instance()->upsertDirectory(pathId, skippedDetails, true);
+            m_engine.m_notify(pathId, fullPath, skippedDetails);
+
+            return true;
+        }
+
+        // New task, unless the directory is being scanned on behalf of another subtree
+        auto pChild = std::make_shared<ScanNode>();
+        pChild->fullPath = fullPath;
+        pChild->pathId = pathId;
+        pChild->pParent = m_pNode;
+
+        {
+            std::scoped_lock lock_(m_pNode->sync);
+            pChild->priority = m_pNode->priority.load();
+            m_pNode->children.push_back(pChild);
+        }
+
+        ++m_pNode->pendingCount;
+
+        auto pClaimed = m_engine.tryClaim(pChild);
+        if (!pClaimed)
+        {
+            m_engine.pushTask(m_workerIndex, std::move(pChild));
+            return true;
+        }
+
+        // The node gets the results of the directory as if it were its own child
+        if (m_engine.tryFollow(*pClaimed, m_pNode))
+        {
+            if (m_pNode->priority > pClaimed->priority)
+                m_engine.changePriority(pClaimed, m_pNode->priority);
+
+            return true;
+        }
+
+        // The other scan has just finished, its results are in the data store
+        --m_pNode->pendingCount;
+        return addSubdirectory(pathId, fullPath);
+    }
+
+    bool isCancellationRequested()
+    {
+        return m_engine.m_isCancellationRequested();
+    }
+};
+
+void
+ParallelScanEngine::processNode(size_t workerIndex, const TScanNodePtr& pNode)
+{
+    if (m_isCancellationRequested())
+    {
+        pNode->abandoned = true;
+    }
+    else
+    {
+        try
+        {
+            listDirectory(workerIndex, pNode);
+        }
+        catch (const std::exception& x)
+        {
+            qCritical() << "ERROR: " << x.what() << endl;
+
+            pNode->failed = true;
+            pNode->pError = std::current_exception();
+        }
+    }
+
+    // Listing itself is done
+    completeNodeTask(pNode);
+}
+
+void
+ParallelScanEngine::listDirectory(size_t workerIndex, const TScanNodePtr& pNode)
+{
+    const QString& dirPath = pNode->fullPath;
+
+    // The subtree root status is maintained by the caller of scanTree()
+    if (!pNode->pScanRoot)
+    {
+        DirectoryDetails dirDetails;
+        dirDetails.status = DirectoryProcessingStatus::Scanning;
+
+        DirectoryStore::instance()->upsertDirectory(pNode->pathId, dirDetails, false);
+        m_notify(pNode->pathId, dirPath, dirDetails);
+    }
+
+    NodeEntrySink sink(*this, workerIndex, pNode);
+
+    // The stamp is taken before listing, so that changes made while listing
+    //  are detected by the next scan
+    const long long startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::optional<DirectoryStamp> stamp;
+    if (m_stampListings)
+        stamp = m_pReader->readDirectoryStamp(dirPath);
+
+    DirectoryListing listing;
+    bool unchanged = m_reuseUnchangedListings &&
+        DirectoryStore::instance()->tryGetDirectoryListing(pNode->pathId, listing) &&
+        listing.stamp.has_value() && stamp.value() == listing.stamp.value();
+
+    if (unchanged)
+    {
+        if (!sink.replayListing(listing))
+        {
+            pNode->abandoned = true;
+            return;
+        }
+    }
+    else
+    {
+        if (!m_pReader->readDirectory(dirPath, sink))
+        {
+            pNode->abandoned = true;
+            return;
+        }
+
+        if (stamp.has_value() && isStampSettled(stamp.value(), startNs))
+            listing.stamp = stamp;
+        else
+            listing.stamp.reset();
+
+        listing.ownStats = sink.ownStats;
+        listing.ownMimeSizes = sink.ownMimeSizes;
+        listing.subdirectories = std::move(sink.subdirectories);
+
+        removeVanishedSubdirectories(pNode->pathId, listing.subdirectories);
+
+        DirectoryStore::instance()->upsertDirectoryListing(pNode->pathId, std::move(listing));
+    }
+
+    // Children roll up into the node concurrently
+    std::scoped_lock lock_(pNode->sync);
+    pNode->stats.addStats(sink.ownStats);
+    pNode->stats.addStats(sink.readyStats);
+    pNode->mimeSizes.addMimeDetails(sink.ownMimeSizes);
+    pNode->mimeSizes.addMimeDetails(sink.readyMimeSizes);
+}
+
+void
+ParallelScanEngine::removeVanishedSubdirectories(TPathId pathId, const std::vector<TPathId>& subdirectories)
+{
+    auto listedSubdirectories = subdirectories;
+    std::sort(listedSubdirectories.begin(), listedSubdirectories.end());
+
+    // Every listed subdirectory is interned as a child, so the others are gone
+    for (auto childId : PathTable::instance()->children(pathId))
+    {
+        if (!std::binary_search(listedSubdirectories.cbegin(), listedSubdirectories.cend(), childId))
+            DirectoryStore::instance()->removeDirectorySubtree(childId);
+    }
+}
+
+bool
+ParallelScanEngine::isStampSettled(const DirectoryStamp& stamp, long long startNs) noexcept
+{
+    return stamp.mtimeNs + SETTLED_STAMP_AGE_NS < startNs &&
+           stamp.ctimeNs + SETTLED_STAMP_AGE_NS < startNs;
+}
+
+void
+ParallelScanEngine::completeNodeTask(TScanNodePtr pNode)
+{
+    // Walk up while the current directory has nothing left to wait for
+    while (pNode && 0 == --pNode->pendingCount)
+    {
+        auto pParent = pNode->pParent;
+
+        resolveNode(*pNode);
+
+        pNode = std::move(pParent);
+    }
+}
+
+void
+ParallelScanEngine::resolveNode(ScanNode& node)
+{
+    DirectoryProcessingStatus status =
+        node.failed ? DirectoryProcessingStatus::Error :
+        node.abandoned ? DirectoryProcessingStatus::Pending :
+        DirectoryProcessingStatus::Ready;
+
+    DirectoryDetails dirDetails;
+    dirDetails.status = status;
+
+    if (DirectoryProcessingStatus::Ready == status)
+    {
+        dirDetails.DirectoryStats::assignStats(node.stats);
+        dirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(node.mimeSizes);
+    }
+
+    // Results are stored before the claim is released, so that an overlapping scan
+    //  either follows this node or finds the results in the data store
+    DirectoryStore::instance()->upsertDirectory(
+        node.pathId, dirDetails, DirectoryProcessingStatus::Ready == status);
+
+    std::vector<TScanNodePtr> followers;
+    {
+        std::scoped_lock lock_(node.sync);
+        node.resolved = true;
+        followers.swap(node.followers);
+    }
+
+    releaseClaim(node);
+
+    if (node.pScanRoot)
+    {
+        resolveRoot(node, dirDetails);
+    }
+    else
+    {
+        m_notify(node.pathId, node.fullPath, dirDetails);
+        rollUp(node, status, *node.pParent);
+    }
+
+    for (auto& pFollower : followers)
+    {
+        rollUp(node, status, *pFollower);
+        completeNodeTask(std::move(pFollower));
+    }
+}
+
+void
+ParallelScanEngine::resolveRoot(ScanNode& node, const DirectoryDetails& dirDetails)
+{
+    bool detached;
+
+    {
+        std::scoped_lock lock_(m_sync);
+        ScanRoot& scanRoot = *node.pScanRoot;
+        --m_unresolvedRootCount;
+
+        // Subtree root is handed over to the caller of scanTree()...
+        detached = scanRoot.detached;
+        if (!detached)
+        {
+            RootResult result;
+            result.status = dirDetails.status;
+            result.stats = node.stats;
+            result.mimeSizes = node.mimeSizes;
+            result.pError = node.pError;
+
+            scanRoot.result = std::move(result);
+        }
+    }
+
+    // ...unless nobody is waiting for it
+    if (detached)
+        m_notify(node.pathId, node.fullPath, dirDetails);
+    else
+        m_cvRootDone.notify_all();
+
+    // Workers may be waiting for the last root in order to stop
+    m_cvWorkAvailable.notify_all();
+}
+
+void
+ParallelScanEngine::rollUp(ScanNode& node, DirectoryProcessingStatus status, ScanNode& target)
+{
+    if (DirectoryProcessingStatus::Ready == status)
+    {
+        const long long nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        // Cumulatively transfer (add) results to the target
+        DirectoryDetails targetDirDetails;
+        targetDirDetails.status = DirectoryProcessingStatus::Scanning;
+
+        bool publish = false;
+        {
+            std::scoped_lock lock_(target.sync);
+            target.stats.addStats(node.stats);
+            target.mimeSizes.addMimeDetails(node.mimeSizes);
+
+            // Intermediate parent results are visible in the data store while scanning
+            if (target.pathId != node.pathId && target.publishedNs + INTERMEDIATE_RESULTS_INTERVAL_NS <= nowNs)
+            {
+                target.publishedNs = nowNs;
+                targetDirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(target.mimeSizes);
+                publish = true;
+            }
+        }
+
+        if (publish)
+            DirectoryStore::instance()->upsertDirectory(target.pathId, targetDirDetails, false);
+    }
+    else if (DirectoryProcessingStatus::Pending == status)
+    {
+        // Target cannot be complete without this directory
+        target.abandoned = true;
+    }
+    else if (target.pathId == node.pathId)
+    {
+        // A subtree root waiting for the same directory fails along with it
+        target.failed = true;
+        target.pError = node.pError;
+    }
+}
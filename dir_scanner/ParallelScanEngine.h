@@ -0,0 +1,235 @@
+#ifndef PARALLELSCANENGINE_H
+#define PARALLELSCANENGINE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <QString>
+
+#include "WorkStealingQueue.h"
+#include "IDirectoryReader.h"
+#include "model/DirectoryDetails.h"
+#include "model/PathTable.h"
+
+// Scans a whole directory subtree with a pool of worker threads.
+// Every worker owns a task queue of directories to be listed; idle workers steal
+//	directories from the queues of busy ones.
+// Results of a directory are rolled up to its parent (post-order) as soon as
+//	the directory itself and all its subdirectories are done.
+// Several subtrees can be scanned concurrently. Focused scans are served first, while
+//	background ones keep progressing on the remaining workers. A directory is never
+//	scanned twice at the same time: an overlapping scan waits for the one in progress.
+class ParallelScanEngine
+{
+public:
+	enum class ScanPriority
+	{
+		Background,
+		Focused,
+
+		Count
+	};
+
+	enum class ScanTreeResult
+	{
+		Complete,
+		Cancelled,
+
+		// Focused scan was detached by detachFocusedScans()
+		Detached
+	};
+
+	typedef std::function<void(TPathId pathId, const QString& unifiedPath, const DirectoryDetails& dirDetails)> TNotifyCallback;
+	typedef std::function<bool()> TCancellationPredicate;
+
+	// isCancellationRequested is polled for every directory entry, so it must be cheap.
+	// workerCount == 0 means one worker per hardware thread.
+	// If stampListings is set, stored listings get the directory stamp (one more stat per directory).
+	// If reuseUnchangedListings is set too, directories whose stamp has not changed since
+	//	the last scan are not re-read, their stored listings are used instead.
+	ParallelScanEngine(
+		unsigned workerCount,
+		std::unique_ptr<IDirectoryReader> pReader,
+		bool stampListings,
+		bool reuseUnchangedListings,
+		TNotifyCallback notify,
+		TCancellationPredicate isCancellationRequested);
+	~ParallelScanEngine();
+
+	// Call before exiting from the program for the sake of graceful work threads completion
+	void fini();
+
+	unsigned workerCount() const noexcept;
+
+	// Scans unifiedPath recursively. Blocks until the scan is complete, cancelled or detached.
+	// A focused scan is detached if detachFocusedScans() is called after detachEpoch
+	//	was obtained by getDetachEpoch().
+	// Throws if unifiedPath itself cannot be scanned.
+	ScanTreeResult scanTree(
+		const QString& unifiedPath,
+		ScanPriority priority,
+		unsigned detachEpoch,
+		DirectoryStats& stats,
+		TMimeDetailsList& mimeSizes);
+
+	unsigned getDetachEpoch();
+
+	// Releases callers of focused scanTree(). The detached scans are not cancelled,
+	//	they go on with background priority and put their results to the data store.
+	void detachFocusedScans();
+
+private:
+	ParallelScanEngine(const ParallelScanEngine&) = delete;
+	ParallelScanEngine& operator=(const ParallelScanEngine&) = delete;
+
+	struct ScanRoot;
+
+	// A directory which is being scanned
+	struct ScanNode
+	{
+		// Unified path
+		QString fullPath;
+		TPathId pathId = InvalidPathId;
+
+		// Null for the root of a scanned subtree
+		std::shared_ptr<ScanNode> pParent;
+
+		// Set for the root of a scanned subtree only
+		std::shared_ptr<ScanRoot> pScanRoot;
+
+		std::atomic<ScanPriority> priority = ScanPriority::Background;
+
+		// A node is queued once more when its priority changes,
+		//	the copy taken first is processed, the other one is dropped
+		std::atomic<bool> taken = false;
+
+		// Results are final, no more followers are accepted
+		std::atomic<bool> resolved = false;
+
+		// Intermediate results were put to the data store (steady clock), protected by sync
+		long long publishedNs = 0;
+
+		// Protects stats, mimeSizes, children and followers
+		std::mutex sync;
+		DirectoryStats stats{ .subdirectoryCount = 0, .totalFileCount = 0, .totalSize = 0 };
+		TMimeDetailsList mimeSizes;
+
+		// Subdirectories queued by this node, for the sake of priority changes
+		std::vector<std::weak_ptr<ScanNode>> children;
+
+		// Nodes of overlapping scans which wait for this one instead of
+		//	scanning the same directory once again
+		std::vector<std::shared_ptr<ScanNode>> followers;
+
+		// Directory listing itself + unfinished subdirectories
+		std::atomic<unsigned long> pendingCount = 1;
+
+		// Scanning of this directory or any of its subdirectories was cancelled
+		std::atomic<bool> abandoned = false;
+
+		// Directory listing failed
+		bool failed = false;
+		std::exception_ptr pError;
+	};
+
+	typedef std::shared_ptr<ScanNode> TScanNodePtr;
+
+	// Shared by all workers
+	std::unique_ptr<IDirectoryReader> m_pReader;
+	const bool m_stampListings;
+	const bool m_reuseUnchangedListings;
+
+	TNotifyCallback m_notify;
+	TCancellationPredicate m_isCancellationRequested;
+
+	typedef std::vector<std::unique_ptr<WorkStealingQueue<TScanNodePtr>>> TQueues;
+
+	std::vector<std::thread> m_workers;
+
+	// One queue per worker in every priority lane
+	TQueues m_queues[static_cast<size_t>(ScanPriority::Count)];
+
+	std::mutex m_sync;
+	std::condition_variable m_cvWorkAvailable;
+	std::atomic<size_t> m_queuedCount = 0;
+	bool m_stopWorkers = false;
+
+	// Result of the subtree root, set when the whole subtree is done
+	struct RootResult
+	{
+		DirectoryProcessingStatus status = DirectoryProcessingStatus::Pending;
+		DirectoryStats stats;
+		TMimeDetailsList mimeSizes;
+		std::exception_ptr pError;
+	};
+
+	// A call of scanTree(). Protected by m_sync.
+	struct ScanRoot
+	{
+		ScanPriority priority = ScanPriority::Background;
+		std::weak_ptr<ScanNode> pNode;
+
+		// The caller does not wait for the result any more
+		bool detached = false;
+		std::optional<RootResult> result;
+	};
+
+	std::condition_variable m_cvRootDone;
+	std::vector<std::shared_ptr<ScanRoot>> m_activeRoots;
+	unsigned m_detachEpoch = 0;
+
+	// Including detached ones. Workers are not stopped until all of them are resolved.
+	size_t m_unresolvedRootCount = 0;
+
+	// Directories being scanned
+	std::mutex m_claimsSync;
+	std::unordered_map<TPathId, std::weak_ptr<ScanNode>> m_claims;
+
+	void worker(size_t workerIndex);
+
+	void pushTask(size_t workerIndex, TScanNodePtr pNode);
+	bool tryTakeTask(size_t workerIndex, TScanNodePtr& pNode);
+
+	// Returns the node which is already scanning the same directory, if any.
+	// Otherwise the directory is claimed by pNode.
+	TScanNodePtr tryClaim(const TScanNodePtr& pNode);
+	void releaseClaim(const ScanNode& node);
+
+	// pFollower gets the results of the followed node when it is resolved.
+	// Returns false if the followed node is resolved already.
+	bool tryFollow(ScanNode& followed, const TScanNodePtr& pFollower);
+
+	// Applies priority to the not yet resolved part of the subtree
+	void changePriority(const TScanNodePtr& pNode, ScanPriority priority);
+
+	void processNode(size_t workerIndex, const TScanNodePtr& pNode);
+	void listDirectory(size_t workerIndex, const TScanNodePtr& pNode);
+
+	// Removes subdirectories which are in the data store, but not in the new listing of their parent
+	//	(removed since the previous scan or the loaded snapshot), so that they are saved as removed
+	static void removeVanishedSubdirectories(TPathId pathId, const std::vector<TPathId>& subdirectories);
+
+	// A stamp taken at startNs can be trusted if the directory had not been
+	//	modified shortly before, otherwise a later modification could leave the same stamp
+	static bool isStampSettled(const DirectoryStamp& stamp, long long startNs) noexcept;
+
+	// Collects results of a directory being listed
+	class NodeEntrySink;
+
+	// Accounts for a finished listing or a finished child and resolves
+	//	all the directories up the tree which have nothing left to wait for
+	void completeNodeTask(TScanNodePtr pNode);
+	void resolveNode(ScanNode& node);
+	void resolveRoot(ScanNode& node, const DirectoryDetails& dirDetails);
+
+	// Adds results of a resolved node to a waiting one (its parent or a follower)
+	static void rollUp(ScanNode& node, DirectoryProcessingStatus status, ScanNode& target);
+};
+
+#endif // PARALLELSCANENGINE_H
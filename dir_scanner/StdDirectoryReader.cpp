@@ -0,0 +1,56 @@
+#include <chrono>
+#include <filesystem>
+
+#include "StdDirectoryReader.h"
+
+const char*
+StdDirectoryReader::name() const noexcept
+{
+    return "std::filesystem";
+}
+
+bool
+StdDirectoryReader::readDirectory(const QString& unifiedPath, IDirectoryEntrySink& sink)
+{
+    for (const auto& entry : std::filesystem::directory_iterator(unifiedPath.toStdWString()))
+    {
+        if (entry.is_symlink())
+            continue;
+
+        if (entry.is_directory())
+        {
+            const auto& name_ = entry.path().filename().wstring();
+
+            if (!sink.onSubdirectory(QString::fromStdWString(name_)))
+                return false;
+        }
+        else if (entry.is_regular_file())
+        {
+            auto extension_ = entry.path().extension().wstring();
+            if (!extension_.empty() && L'.' == extension_[0])
+                extension_ = extension_.substr(1);
+
+            const TExtensionId extensionId =
+                ExtensionTable::instance()->intern(QString::fromStdWString(extension_));
+
+            if (!sink.onRegularFile(extensionId, entry.file_size()))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+DirectoryStamp
+StdDirectoryReader::readDirectoryStamp(const QString& unifiedPath)
+{
+    // Only the last write time is available portably
+    const auto lastWriteTime = std::filesystem::last_write_time(unifiedPath.toStdWString());
+
+    // Since the Unix epoch, same as system_clock
+    DirectoryStamp stamp;
+    stamp.mtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::file_clock::to_sys(lastWriteTime).time_since_epoch()).count();
+
+    return stamp;
+}
@@ -0,0 +1,17 @@
+#ifndef STDDIRECTORYREADER_H
+#define STDDIRECTORYREADER_H
+
+#include "IDirectoryReader.h"
+
+// Portable directory reader based on std::filesystem::directory_iterator
+class StdDirectoryReader : public IDirectoryReader
+{
+public:
+	virtual const char* name() const noexcept override;
+
+	virtual bool readDirectory(const QString& unifiedPath, IDirectoryEntrySink& sink) override;
+
+	virtual DirectoryStamp readDirectoryStamp(const QString& unifiedPath) override;
+};
+
+#endif // STDDIRECTORYREADER_H
@@ -0,0 +1,52 @@
+#ifndef WORKSTEALINGQUEUE_H
+#define WORKSTEALINGQUEUE_H
+
+#include <deque>
+#include <mutex>
+
+// Per-worker double-ended task queue.
+// The owning worker pushes and pops at the back (depth-first, cache friendly),
+//	other workers steal from the front, which holds the oldest tasks,
+//	i.e. the ones closest to the subtree root and thus usually the biggest ones.
+template <typename T>
+class WorkStealingQueue
+{
+public:
+	void push(T item)
+	{
+		std::scoped_lock lock_(m_sync);
+		m_items.push_back(std::move(item));
+	}
+
+	// Owner side
+	bool tryPop(T& item)
+	{
+		std::scoped_lock lock_(m_sync);
+
+		if (m_items.empty())
+			return false;
+
+		item = std::move(m_items.back());
+		m_items.pop_back();
+		return true;
+	}
+
+	// Thief side
+	bool trySteal(T& item)
+	{
+		std::scoped_lock lock_(m_sync);
+
+		if (m_items.empty())
+			return false;
+
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex m_sync;
+	std::deque<T> m_items;
+};
+
+#endif // WORKSTEALINGQUEUE_H
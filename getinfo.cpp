@@ -1,5 +1,7 @@
 #include <functional>
+#include <algorithm>
 #include <QDebug>
+#include <QInputDialog>
 #include <QMessageBox>
 
 #include "getinfo.h"
@@ -16,6 +18,9 @@
 #define DIVISOR_VALUE_KB "KB"
 #define DIVISOR_VALUE_MB "MB"
 
+// Directories shown for each direction of change
+#define SNAPSHOT_DIFF_TOP_COUNT 50
+
 using namespace std::placeholders;
 
 GetInfo::GetInfo(QWidget* parent)
@@ -23,6 +28,7 @@ GetInfo::GetInfo(QWidget* parent)
       ui(new Ui::GetInfo),
       m_dirSizeHistoryGraph(nullptr),
       m_deselectingTreeView(false),
+      m_updatingMimeSizes(false),
       m_scanningAllDirectories(false)
 {
     ui->setupUi(this);
@@ -51,8 +57,24 @@ GetInfo::GetInfo(QWidget* parent)
         ui->treeDirectories->selectionModel(),
         SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)),
         this, SLOT(treeDirectoriesSelectionChanged(const QItemSelection&, const QItemSelection&)));
+    connect(
+        ui->treeDirectories, SIGNAL(expanded(const QModelIndex&)),
+        this, SLOT(treeDirectoryExpanded(const QModelIndex&)));
+    connect(
+        ui->treeDirectories, SIGNAL(collapsed(const QModelIndex&)),
+        this, SLOT(treeDirectoryCollapsed(const QModelIndex&)));
 
     ui->tableMimeSizes->setModel(&m_msModel);
+    ui->tableMimeSizes->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->tableMimeSizes->setSelectionMode(QAbstractItemView::ExtendedSelection);
+
+    connect(
+        ui->tableMimeSizes->selectionModel(),
+        SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)),
+        this, SLOT(tableMimeSizesSelectionChanged(const QItemSelection&, const QItemSelection&)));
+
+    ui->tableSnapshotDiff->setModel(&m_sdModel);
+    ui->tableSnapshotDiff->setColumnWidth(0, 250);
 
     ui->actionSwitchToBytes->setChecked(true);
     connect(ui->actionSwitchToBytes, SIGNAL(triggered()), this, SLOT(switchToBytes()));
@@ -60,11 +82,22 @@ GetInfo::GetInfo(QWidget* parent)
     connect(ui->actionSwitchToMBytes, SIGNAL(triggered()), this, SLOT(switchToMBytes()));
 
     connect(ui->actionSaveSnapshot, SIGNAL(triggered()), this, SLOT(startSavingSnapshot()));
+    connect(ui->actionCompareSnapshots, SIGNAL(triggered()), this, SLOT(startComparingSnapshots()));
     connect(ui->actionScanAll, SIGNAL(triggered()), this, SLOT(scanAllDirectories()));
 
 //    connect(m_dirSizeHistoryGraph, SIGNAL(destroyed()), &KDateTimeSeriesChartView::onDestroyed);
 
     DirectoryScanner::instance()->subscribe(this);
+
+    // Top level directories are always visible
+    DirectoryScanner::instance()->setDirectoryExpanded(this, rootPath, true);
+
+    // Numbers of the last snapshot are shown until directories are scanned again,
+    //  a database saved by an older version is upgraded before
+    if (DirectoryStore::instance()->isUpgradeNeeded())
+        startUpgradingDatabase();
+    else
+        DirectoriesScanOrchestrator::instance()->startWarmStart();
 }
 
 GetInfo::~GetInfo()
@@ -97,21 +130,8 @@ GetInfo::treeDirectoriesSelectionChanged(
         m_deselectingTreeView = false;
     });
 
-    // Check if full scan is in progress in order to prevent accidental abort of scanning
-    if (m_scanningAllDirectories &&
-        QMessageBox::No == QMessageBox::question(
-            this, tr("Question"), tr("Full scan is in progress. Would you like to cancel full scan?"),
-            QMessageBox::Yes | QMessageBox::No))
-    {
-        // Cancel selection
-        auto selectionModel = ui->treeDirectories->selectionModel();
-        selectionModel->select(selected, QItemSelectionModel::Deselect);
-        selectionModel->select(deselected, QItemSelectionModel::Select);
-        return;
-    }
-
     // Reset MIME type total sizes
-    m_msModel.setMimeSizes(KMimeSizesInfo::KMimeSizesList());
+    setMimeSizes(KMimeSizesInfo::KMimeSizesList());
 
     auto selectedindexes = selected.indexes();
     int selectedCount = selectedindexes.count();
@@ -119,33 +139,89 @@ GetInfo::treeDirectoriesSelectionChanged(
     if (0 == selectedCount)
     {
         m_unifiedSelectedPath.clear();
+        DirectoryScanner::instance()->setDirectorySelected(this, m_unifiedSelectedPath);
     }
     else
     {
         auto selectedIndex = selectedindexes.first();
         m_unifiedSelectedPath = getUnifiedPathName(m_fsModel.filePath(selectedIndex));
 
-        std::vector<QString> dirs;
-        dirs.push_back(m_unifiedSelectedPath);
-        DirectoriesScanOrchestrator::instance()->scanDirectoriesSequentially(dirs, [self = this]()
-        {
-#if 0
-                bool res = QMetaObject::invokeMethod(
-                    self, "", Qt::QueuedConnection);
-                assert(res);
-#endif
-        });
+        // Current results are delivered immediately
+        DirectoryScanner::instance()->setDirectorySelected(this, m_unifiedSelectedPath);
+
+        // Full scan, if any, goes on in the background
+        DirectoriesScanOrchestrator::instance()->focusDirectory(m_unifiedSelectedPath);
 
         startUpdatingHistoryGraph();
     }
 }
 
+void
+GetInfo::tableMimeSizesSelectionChanged(
+    const QItemSelection& selected, const QItemSelection& deselected)
+{
+    if (m_updatingMimeSizes)
+        return;
+
+    std::vector<QString> selectedMimeTypes;
+    for (const auto& index : ui->tableMimeSizes->selectionModel()->selectedRows())
+    {
+        // The whole directory is shown anyway
+        const auto& mimeType = m_msModel.mimeType(index.row());
+        if (TMimeDetailsList::ALL_MIMETYPE != mimeType)
+            selectedMimeTypes.push_back(mimeType);
+    }
+
+    std::sort(selectedMimeTypes.begin(), selectedMimeTypes.end());
+    if (selectedMimeTypes == m_selectedMimeTypes)
+        return;
+
+    m_selectedMimeTypes.swap(selectedMimeTypes);
+    startUpdatingHistoryGraph();
+}
+
+void
+GetInfo::setMimeSizes(KMimeSizesInfo::KMimeSizesList&& mimeSizes)
+{
+    m_updatingMimeSizes = true;
+    auto endUpdatingMimeSizes = scope_guard([&](auto) {
+        m_updatingMimeSizes = false;
+    });
+
+    m_msModel.setMimeSizes(std::move(mimeSizes));
+
+    // Rows are reused for other mime types, so selection follows the mime types
+    QItemSelection selection;
+
+    const int rowCount = m_msModel.rowCount(QModelIndex());
+    for (int row = 0; row < rowCount; ++row)
+    {
+        const auto& mimeType = m_msModel.mimeType(row);
+        if (std::binary_search(m_selectedMimeTypes.cbegin(), m_selectedMimeTypes.cend(), mimeType))
+            selection.select(m_msModel.index(row, 0), m_msModel.index(row, KMimeSizesModel::NumColumns - 1));
+    }
+
+    ui->tableMimeSizes->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
+}
+
+void
+GetInfo::treeDirectoryExpanded(const QModelIndex& index)
+{
+    DirectoryScanner::instance()->setDirectoryExpanded(this, m_fsModel.filePath(index), true);
+}
+
+void
+GetInfo::treeDirectoryCollapsed(const QModelIndex& index)
+{
+    DirectoryScanner::instance()->setDirectoryExpanded(this, m_fsModel.filePath(index), false);
+}
+
 void
 GetInfo::startUpdatingHistoryGraph()
 {
     if (!m_unifiedSelectedPath.isEmpty())
     {
-        HistoryProvider::instance()->getDirectoryHistoryAsync(m_unifiedSelectedPath,
+        HistoryProvider::instance()->getDirectoryHistoryAsync(m_unifiedSelectedPath, m_selectedMimeTypes,
             [self = this](auto pHistory) {
                 bool res = QMetaObject::invokeMethod(
                     self, "updateHistoryGraph", Qt::QueuedConnection,
@@ -166,6 +242,7 @@ GetInfo::switchToBytes()
 
     m_fsModel.setFileSizeDivisor(FileSizeDivisor::Bytes);
     m_msModel.setFileSizeDivisor(FileSizeDivisor::Bytes);
+    m_sdModel.setFileSizeDivisor(FileSizeDivisor::Bytes);
     m_chartModel.setFileSizeDivisor(FileSizeDivisor::Bytes);
 }
 
@@ -180,6 +257,7 @@ GetInfo::switchToKBytes()
 
     m_fsModel.setFileSizeDivisor(FileSizeDivisor::KBytes);
     m_msModel.setFileSizeDivisor(FileSizeDivisor::KBytes);
+    m_sdModel.setFileSizeDivisor(FileSizeDivisor::KBytes);
     m_chartModel.setFileSizeDivisor(FileSizeDivisor::KBytes);
 }
 
@@ -194,24 +272,16 @@ GetInfo::switchToMBytes()
 
     m_fsModel.setFileSizeDivisor(FileSizeDivisor::MBytes);
     m_msModel.setFileSizeDivisor(FileSizeDivisor::MBytes);
+    m_sdModel.setFileSizeDivisor(FileSizeDivisor::MBytes);
     m_chartModel.setFileSizeDivisor(FileSizeDivisor::MBytes);
 }
 
 void
-GetInfo::onUpdateDirectoryInfo(KDirectoryInfoPtr pInfo)
-{
-    bool res = QMetaObject::invokeMethod(
-        this, "updateDirectoryInfo", Qt::QueuedConnection,
-        Q_ARG(KDirectoryInfoPtr, pInfo));
-    assert(res);
-}
-
-void
-GetInfo::onUpdateMimeSizes(KMimeSizesInfoPtr pInfo)
+GetInfo::onUpdateBatch(KScanUpdateBatchPtr pBatch)
 {
     bool res = QMetaObject::invokeMethod(
-        this, "updateMimeSizes", Qt::QueuedConnection,
-        Q_ARG(KMimeSizesInfoPtr, pInfo));
+        this, "updateBatch", Qt::QueuedConnection,
+        Q_ARG(KScanUpdateBatchPtr, pBatch));
     assert(res);
 }
 
@@ -225,23 +295,22 @@ GetInfo::onWorkerException(std::exception_ptr&& pEx)
 }
 
 void
-GetInfo::updateDirectoryInfo(KDirectoryInfoPtr pInfo)
+GetInfo::updateBatch(KScanUpdateBatchPtr pBatch)
 {
     assert(ui);
 
-    m_fsModel.SetDirectoryInfo(*pInfo);
-}
-
-void
-GetInfo::updateMimeSizes(KMimeSizesInfoPtr pInfo)
-{
-    assert(ui);
+    for (const auto& pInfo : pBatch->dirInfos)
+        m_fsModel.SetDirectoryInfo(*pInfo);
 
-    // Updated directory
-    QString updatedPath = getUnifiedPathName(pInfo->fullPath);
+    for (const auto& pInfo : pBatch->mimeSizesInfos)
+    {
+        // Updated directory
+        QString updatedPath = getUnifiedPathName(pInfo->fullPath);
 
-    if (m_unifiedSelectedPath == updatedPath)
-        m_msModel.setMimeSizes(std::move(pInfo->mimeSizes));
+        // The batch is shared, thus copied
+        if (m_unifiedSelectedPath == updatedPath)
+            setMimeSizes(KMimeSizesInfo::KMimeSizesList(pInfo->mimeSizes));
+    }
 }
 
 void
@@ -316,6 +385,27 @@ GetInfo::writeSettings()
         assert(!"Unexpected divisor selection");
 }
 
+void
+GetInfo::startUpgradingDatabase()
+{
+    assert(!m_progressDlg);
+    m_progressDlg = std::make_unique<ProgressDlg>(this,
+        tr("Upgrade database"),
+        tr("Please wait..."),
+        [](const ProgressDlg::TProgressCallback& onProgress) {
+            DirectoryStore::instance()->upgradeDatabase(onProgress);
+        },
+        std::bind(&GetInfo::onCompleteUpgradingDatabase, this));
+}
+
+void
+GetInfo::onCompleteUpgradingDatabase()
+{
+    m_progressDlg.reset();
+
+    DirectoriesScanOrchestrator::instance()->startWarmStart();
+}
+
 void
 GetInfo::startSavingSnapshot()
 {
@@ -341,6 +431,78 @@ GetInfo::saveSnapshot()
     DirectoryStore::instance()->saveCurrentData();
 }
 
+void
+GetInfo::startComparingSnapshots()
+{
+    assert(!m_progressDlg);
+
+    const auto& snapshots = DirectoryStore::instance()->getSnapshots();
+    if (snapshots.size() < 2)
+    {
+        QMessageBox::information(this, tr("Compare snapshots"),
+            tr("At least two saved snapshots are needed for comparison"));
+        return;
+    }
+
+    // Labels start with IDs, so that snapshots saved within a second differ
+    QStringList items;
+    for (const auto& snapshot : snapshots)
+        items.append(QString("%1: %2").arg(snapshot.first).arg(convertToQDateTime(snapshot.second).toString()));
+
+    // The last two snapshots are offered by default
+    bool ok = false;
+    const auto& fromItem = QInputDialog::getItem(this, tr("Compare snapshots"),
+        tr("Compare from snapshot:"), items, items.size() - 2, false, &ok);
+    if (!ok)
+        return;
+
+    const auto& toItem = QInputDialog::getItem(this, tr("Compare snapshots"),
+        tr("Compare to snapshot:"), items, items.size() - 1, false, &ok);
+    if (!ok)
+        return;
+
+    const auto fromIndex = items.indexOf(fromItem);
+    const auto toIndex = items.indexOf(toItem);
+    if (0 > fromIndex || 0 > toIndex || fromIndex == toIndex)
+    {
+        QMessageBox::information(this, tr("Compare snapshots"),
+            tr("Two different snapshots are needed for comparison"));
+        return;
+    }
+
+    m_fromSnapshot = snapshots[fromIndex];
+    m_toSnapshot = snapshots[toIndex];
+
+    m_progressDlg = std::make_unique<ProgressDlg>(this,
+        tr("Compare snapshots"),
+        tr("Please wait..."),
+        std::bind(&GetInfo::compareSnapshots, this),
+        std::bind(&GetInfo::onCompleteComparingSnapshots, this));
+}
+
+void
+GetInfo::compareSnapshots()
+{
+    m_snapshotDiff = DirectoryStore::instance()->diffSnapshots(
+        m_fromSnapshot.first, m_toSnapshot.first, SNAPSHOT_DIFF_TOP_COUNT);
+    m_snapshotDiffCaption = tr("%L1 directories changed from %2 to %3")
+        .arg(m_snapshotDiff.changedDirectoryCount)
+        .arg(convertToQDateTime(m_fromSnapshot.second).toString())
+        .arg(convertToQDateTime(m_toSnapshot.second).toString());
+}
+
+void
+GetInfo::onCompleteComparingSnapshots()
+{
+    m_progressDlg.reset();
+
+    m_sdModel.setSnapshotDiff(std::move(m_snapshotDiff));
+    m_snapshotDiff = DirectoryStore::SnapshotDiff();
+
+    ui->statusbar->showMessage(m_snapshotDiffCaption);
+    m_snapshotDiffCaption.clear();
+}
+
 void
 GetInfo::scanAllDirectories()
 {
@@ -393,7 +555,7 @@ GetInfo::updateHistoryGraph(HistoryProvider::TDirectoryHistoryPtr pHistory)
     });
 
     auto& history = *pHistory;
-    for (const auto& iter : history)
+    for (const auto& iter : history.totalSizes)
     {
         auto dtUtc = iter.first;
         auto totalSize = iter.second;
@@ -404,4 +566,10 @@ GetInfo::updateHistoryGraph(HistoryProvider::TDirectoryHistoryPtr pHistory)
 
         m_chartModel.appendSeriesDateValue(dtUtc, totalSize);
     }
+
+    for (const auto& mimeTypeIter : history.mimeTypeSizes)
+    {
+        for (const auto& iter : mimeTypeIter.second)
+            m_chartModel.appendSeriesDateValue(mimeTypeIter.first, iter.first, iter.second);
+    }
 }
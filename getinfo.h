@@ -5,6 +5,7 @@
 #include <thread>
 #include <future>
 #include <mutex>
+#include <vector>
 #include <QMainWindow>
 #include <QItemSelectionModel>
 
@@ -12,6 +13,7 @@
 #include "ProgressDlg.h"
 #include "view_model/kfilesystemmodel.h"
 #include "view_model/kmimesizesmodel.h"
+#include "view_model/ksnapshotdiffmodel.h"
 #include "view_model/kdatetimeserieschartmodel.h"
 #include "dir_scanner/IDirectoryScannerEventSink.h"
 #include "model/HistoryProvider.h"
@@ -32,8 +34,7 @@ public:
     // IDirectoryScannerEventSink interface
     //
 
-    virtual void onUpdateDirectoryInfo(KDirectoryInfoPtr pInfo) override;
-    virtual void onUpdateMimeSizes(KMimeSizesInfoPtr pInfo) override;
+    virtual void onUpdateBatch(KScanUpdateBatchPtr pBatch) override;
     virtual void onWorkerException(std::exception_ptr&& pEx) override;
 
 private:
@@ -44,19 +45,26 @@ private:
     // Unified path of currently selected path
     QString m_unifiedSelectedPath;
 
+    // Mime types whose history is shown along with the total size, kept for other directories
+    std::vector<QString> m_selectedMimeTypes;
+
     // Models for views
     KFileSystemModel m_fsModel;
     KMimeSizesModel m_msModel;
+    KSnapshotDiffModel m_sdModel;
     KDateTimeSeriesChartModel m_chartModel;
 
     // This flag is used to avoid infinite recursion while cancelling selection in TreeView
     bool m_deselectingTreeView;
 
+    // Selection of mime types is not changed by the user while their table is updated
+    bool m_updatingMimeSizes;
+
     // Indicates if full scann is in progress
     bool m_scanningAllDirectories;
 
-    Q_INVOKABLE void updateDirectoryInfo(KDirectoryInfoPtr pInfo);
-    Q_INVOKABLE void updateMimeSizes(KMimeSizesInfoPtr pInfo);
+    // Releasing the batch lets the scanner deliver the next one
+    Q_INVOKABLE void updateBatch(KScanUpdateBatchPtr pBatch);
     Q_INVOKABLE void workerException(const std::exception_ptr& pEx);
 
     // Restores 'Scan All' button state
@@ -65,14 +73,32 @@ private:
     // Updates history graph with history data
     Q_INVOKABLE void updateHistoryGraph(HistoryProvider::TDirectoryHistoryPtr pHistory);
 
+    // Updates the table of mime types keeping selected ones selected
+    void setMimeSizes(KMimeSizesInfo::KMimeSizesList&& mimeSizes);
+
     void readSettings();
     void writeSettings();
 
     std::unique_ptr<ProgressDlg> m_progressDlg;
 
+    // Upgrades a database saved by an older version, then starts warm start
+    void startUpgradingDatabase();
+    void onCompleteUpgradingDatabase();
+
     void saveSnapshot();
     void onCompleteSavingSnapshot();
 
+    // Snapshots picked for comparison
+    DirectoryStore::TSnapshotList::value_type m_fromSnapshot;
+    DirectoryStore::TSnapshotList::value_type m_toSnapshot;
+
+    // Result of the last comparison, passed from the worker to the model
+    DirectoryStore::SnapshotDiff m_snapshotDiff;
+    QString m_snapshotDiffCaption;
+
+    void compareSnapshots();
+    void onCompleteComparingSnapshots();
+
 protected:
     virtual void showEvent(QShowEvent* event) override;
     virtual void closeEvent(QCloseEvent* event) override;
@@ -81,6 +107,14 @@ private slots:
     void treeDirectoriesSelectionChanged(
         const QItemSelection& selected, const QItemSelection& deselected);
 
+    // Shows history of the selected mime types
+    void tableMimeSizesSelectionChanged(
+        const QItemSelection& selected, const QItemSelection& deselected);
+
+    // Keep the scanner informed about directories being shown
+    void treeDirectoryExpanded(const QModelIndex& index);
+    void treeDirectoryCollapsed(const QModelIndex& index);
+
     void switchToBytes();
     void switchToKBytes();
     void switchToMBytes();
@@ -88,6 +122,9 @@ private slots:
     // Saves scan results to DB
     void startSavingSnapshot();
 
+    // Ranks directories by size change between two snapshots picked by the user
+    void startComparingSnapshots();
+
     // Starts requesting history info for a selected directory and updating graph
     void startUpdatingHistoryGraph();
 
@@ -26,6 +26,7 @@ main(int argc, char *argv[])
         qRegisterMetaType<std::exception_ptr>("std::exception_ptr");
         qRegisterMetaType<KDirectoryInfoPtr>("KDirectoryInfoPtr");
         qRegisterMetaType<KMimeSizesInfoPtr>("KMimeSizesInfoPtr");
+        qRegisterMetaType<KScanUpdateBatchPtr>("KScanUpdateBatchPtr");
         qRegisterMetaType<HistoryProvider::TDirectoryHistoryPtr>("HistoryProvider::TDirectoryHistoryPtr");
 
         // Call all dtor-s
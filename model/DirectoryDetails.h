@@ -11,8 +11,10 @@
 struct DirectoryDetails : DirectoryStatsWithStatus
 {
 	bool scan = false;
-	std::optional<TMimeDetailsList> mimeDetailsList = {};
+	// Never modified in place, a new list replaces the old one (nullptr if not known)
+	TMimeDetailsListPtr mimeDetailsList;
 
+	// Mime details are shared, not copied
 	DirectoryDetails clone(bool cloneMimeDetails) const
 	{
 		DirectoryDetails retVal{
@@ -20,7 +22,7 @@ struct DirectoryDetails : DirectoryStatsWithStatus
 			    .totalFileCount = totalFileCount,
 			    .totalSize = totalSize }, status },
 			scan,
-			cloneMimeDetails ? mimeDetailsList : std::optional<TMimeDetailsList>{}
+			cloneMimeDetails ? mimeDetailsList : TMimeDetailsListPtr{}
 		};
 
 		return retVal;
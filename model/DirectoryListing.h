@@ -0,0 +1,38 @@
+#ifndef DIRECTORYLISTING_H
+#define DIRECTORYLISTING_H
+
+#include <optional>
+#include <vector>
+
+#include "DirectoryStats.h"
+#include "MimeDetails.h"
+#include "PathTable.h"
+
+// Directory's own metadata. Changes whenever an immediate entry
+//	is created, removed or renamed (but not when a file is rewritten in place).
+// Times are in nanoseconds since the Unix epoch.
+// Fields which are not available on a platform are 0.
+struct DirectoryStamp
+{
+	long long mtimeNs = 0;
+	long long ctimeNs = 0;
+	unsigned long long inode = 0;
+	unsigned long long device = 0;
+
+	bool operator==(const DirectoryStamp& rhs) const = default;
+};
+
+// Immediate entries of a directory as of the last listing, used by incremental rescan
+struct DirectoryListing
+{
+	// Not set if the directory was being modified while listed
+	std::optional<DirectoryStamp> stamp;
+
+	// Files of the directory itself, without subdirectories
+	DirectoryStats ownStats;
+	TMimeDetailsList ownMimeSizes;
+
+	std::vector<TPathId> subdirectories;
+};
+
+#endif // DIRECTORYLISTING_H
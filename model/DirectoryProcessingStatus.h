@@ -9,6 +9,7 @@ enum class DirectoryProcessingStatus
 	Ready,
 	Skipped,
 	Error,
+	Stale,		// Scanned before, but the results could be outdated
 };
 
 #endif // DIRECTORYPROCESSINGSTATUS_H
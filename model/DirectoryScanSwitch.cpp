@@ -35,13 +35,13 @@ DirectoryScanSwitch::readSettings()
 	std::for_each(enabled.cbegin(), enabled.cend(), [&](auto path) {
 		const QString& sPath = path.toString();
 		if (!sPath.isEmpty())
-			m_scanSwitches.emplace(std::make_pair(sPath, true));
+			m_scanSwitches.emplace(std::make_pair(PathTable::instance()->intern(sPath), true));
 	});
 
 	std::for_each(disabled.cbegin(), disabled.cend(), [&](auto path) {
 		const QString& sPath = path.toString();
 		if (!sPath.isEmpty())
-			m_scanSwitches.emplace(std::make_pair(sPath, false));
+			m_scanSwitches.emplace(std::make_pair(PathTable::instance()->intern(sPath), false));
 	});
 }
 
@@ -55,9 +55,12 @@ DirectoryScanSwitch::writeSettings()
 
 	for (auto iter = m_scanSwitches.cbegin(); iter != m_scanSwitches.cend(); ++iter)
 	{
-		const auto& path = iter->first;
+		const auto& path = PathTable::instance()->path(iter->first);
 		bool isEnabled = iter->second;
 
+		if (path.isEmpty())
+			continue;
+
 		if (isEnabled)
 			enabled.push_back(path);
 		else
@@ -71,11 +74,19 @@ DirectoryScanSwitch::writeSettings()
 bool
 DirectoryScanSwitch::isEnabled(const QString& unifiedPath) const noexcept
 {
+	return isEnabled(PathTable::instance()->intern(unifiedPath));
+}
+
+bool
+DirectoryScanSwitch::isEnabled(TPathId pathId) const noexcept
+{
+	auto pPathTable = PathTable::instance();
+
 	std::scoped_lock lock_(m_sync);
 
-	for (auto path = unifiedPath; !path.isEmpty(); path = getImmediateParent(path))
+	for (auto id = pathId; InvalidPathId != id; id = pPathTable->parent(id))
 	{
-		auto iter = m_scanSwitches.find(path);
+		auto iter = m_scanSwitches.find(id);
 		if (iter != m_scanSwitches.end())
 		{
 			bool enabled = iter->second;
@@ -90,10 +101,13 @@ DirectoryScanSwitch::isEnabled(const QString& unifiedPath) const noexcept
 void
 DirectoryScanSwitch::setEnabled(const QString& unifiedPath, bool enableScan)
 {
+	auto pPathTable = PathTable::instance();
+	const TPathId pathId = pPathTable->intern(unifiedPath);
+
 	std::scoped_lock lock_(m_sync);
 
 	// Check if value is defined for this particular path (not for a parent)
-	auto iter = m_scanSwitches.find(unifiedPath);
+	auto iter = m_scanSwitches.find(pathId);
 	if (iter != m_scanSwitches.end() &&
 		iter->second != enableScan)
 	{
@@ -102,16 +116,16 @@ DirectoryScanSwitch::setEnabled(const QString& unifiedPath, bool enableScan)
 	}
 
 	bool insertValue = true;
-	if (!unifiedPath.isEmpty())
+	if (InvalidPathId != pathId)
 	{
-		QString path;
+		TPathId id;
 
 		// Check if parent value is the same
-		for (path = getImmediateParent(unifiedPath);
-			 !path.isEmpty();
-			 path = getImmediateParent(path))
+		for (id = pPathTable->parent(pathId);
+			 InvalidPathId != id;
+			 id = pPathTable->parent(id))
 		{
-			auto iter = m_scanSwitches.find(path);
+			auto iter = m_scanSwitches.find(id);
 			if (iter != m_scanSwitches.end())
 			{
 				bool parentEnabled = iter->second;
@@ -125,20 +139,19 @@ DirectoryScanSwitch::setEnabled(const QString& unifiedPath, bool enableScan)
 
 		// Also if enableScan and there's no parent with disable scan state,
 		//	nothing to be set (enabled by default)
-		if (path.isEmpty() && enableScan)
+		if (InvalidPathId == id && enableScan)
 			insertValue = false;
 	}
 
 	// Overwrite all children states
 	for (auto iter = m_scanSwitches.begin(); iter != m_scanSwitches.end();)
 	{
-		const auto& path = iter->first;
-		if (path.startsWith(unifiedPath))
+		if (pPathTable->isSameOrDescendant(iter->first, pathId))
 			iter = m_scanSwitches.erase(iter);
 		else
 			++iter;
 	}
 
 	if (insertValue)
-		m_scanSwitches.insert(std::make_pair(unifiedPath, enableScan));
+		m_scanSwitches.insert(std::make_pair(pathId, enableScan));
 }
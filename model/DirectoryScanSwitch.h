@@ -1,10 +1,12 @@
 #ifndef DIRECTORYSCANSWITCH_H
 #define DIRECTORYSCANSWITCH_H
 
-#include <map>
+#include <unordered_map>
 #include <mutex>
 #include <QString>
 
+#include "PathTable.h"
+
 class DirectoryScanSwitch
 {
 	DirectoryScanSwitch();
@@ -21,14 +23,15 @@ public:
 	void fini();
 
 	bool isEnabled(const QString& unifiedPath) const noexcept;
+	bool isEnabled(TPathId pathId) const noexcept;
 	void setEnabled(const QString& unifiedPath, bool enableScan = true);
 
 private:
 
 	mutable std::mutex m_sync;
 
-	std::map<
-		QString,	// unified path
+	std::unordered_map<
+		TPathId,	// interned unified path
 		bool		// scan directory
 	> m_scanSwitches;
 
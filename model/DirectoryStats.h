@@ -17,6 +17,16 @@ std::optional<T>& operator+=(std::optional<T>& lhs, const std::optional<T>& rhs)
 	return lhs;
 }
 
+// Clamped at 0
+template <typename T>
+std::optional<T>& operator-=(std::optional<T>& lhs, const std::optional<T>& rhs)
+{
+	if (rhs.has_value() && lhs.has_value())
+		lhs = lhs.value() > rhs.value() ? lhs.value() - rhs.value() : 0;
+
+	return lhs;
+}
+
 struct DirectoryStats
 {
 	// Immediate subdirectory count
@@ -41,6 +51,13 @@ struct DirectoryStats
 		totalFileCount += rhs.totalFileCount;
 		totalSize += rhs.totalSize;
 	}
+
+	void subtractStats(const DirectoryStats& rhs)
+	{
+		subdirectoryCount -= rhs.subdirectoryCount;
+		totalFileCount -= rhs.totalFileCount;
+		totalSize -= rhs.totalSize;
+	}
 };
 
 struct DirectoryStatsWithStatus : DirectoryStats
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <queue>
+#include <QDebug>
 #include <yasw/SqliteDb.h>
 #include "DirectoryStore.h"
 #include "utils.h"
@@ -5,8 +8,96 @@
 
 #define SQL_TABLE_SNAPSHOTS L"snapshots"
 #define SQL_TABLE_DIRECTORIES L"directories"
+#define SQL_TABLE_PATHS L"paths"
+#define SQL_TABLE_EXTENSIONS L"extensions"
+#define SQL_TABLE_MIME_DETAILS L"mime_details"
+
+// Rows of a directory are kept together ordered by snapshot, so the primary key
+//	covers both the history of a directory and the latest row of each directory
+#define SQL_CREATE_TABLE_DIRECTORIES \
+	L"CREATE TABLE " SQL_TABLE_DIRECTORIES L" (\n" \
+	L"path_id INTEGER NOT NULL,\n" \
+	L"snapshot_id INTEGER NOT NULL,\n" \
+	L"total_file_count INTEGER NOT NULL,\n" \
+	L"total_size INTEGER NOT NULL,\n" \
+	L"subdir_count INTEGER NOT NULL,\n" \
+	L"removed INTEGER NOT NULL DEFAULT 0,\n" \
+	L"PRIMARY KEY (path_id, snapshot_id),\n" \
+	L"FOREIGN KEY (path_id) REFERENCES " SQL_TABLE_PATHS L"(id),\n" \
+	L"FOREIGN KEY (snapshot_id) REFERENCES " SQL_TABLE_SNAPSHOTS L"(id)\n" \
+	L") WITHOUT ROWID"
+
+#define STORE_PREFIX "store"
+#define STORE_MEMORY_BUDGET_NAME STORE_PREFIX "/memory_budget_mb"
+#define STORE_MIME_DETAILS_MIN_SIZE_NAME STORE_PREFIX "/mime_details_min_size_mb"
+
+// Rows inserted by a single statement, 6 parameters each (within SQLite's default limit of 999)
+#define SAVE_SNAPSHOT_BATCH_SIZE 100
+
+// Directories loaded from a snapshot are put to the store and reported by this many
+#define LOAD_SNAPSHOT_BATCH_SIZE 1000
+
+// Spilling stops when memory is this much within the budget, so that it does not run on every update
+#define SPILL_TARGET_PERCENT 90
+
+// Snapshots are diffed by looking up the changed directories one by one if at most this
+//	share (1/N) of saved paths changed, otherwise by a single scan of the directories table
+//	(a lookup costs about as much as scanning the rows of 12 directories)
+#define DIFF_SEEK_PATH_RATIO 16
+
+// Sums of subdirectory deltas kept while diffing snapshots are pruned no sooner than at this size
+#define DIFF_CHILD_DELTAS_MIN_PRUNE_SIZE 4096
+
+namespace
+{
+	// Multi-row insert, so that a statement is prepared per batch rather than per row.
+	//	onBatch gets the number of rows inserted so far.
+	template <typename TAddRowParameters>
+	void
+	insertBatched(
+		SqliteDb& db,
+		const wchar_t* sqlInsert,
+		const wchar_t* sqlValues,
+		size_t rowCount,
+		const TAddRowParameters& addRowParameters,
+		const std::function<void(size_t)>& onBatch = {})
+	{
+		const auto makeSql = [&](size_t batchSize) {
+			std::wstring sql = sqlInsert;
+			sql += L" VALUES ";
+
+			for (size_t i = 0; i < batchSize; ++i)
+			{
+				if (0 != i)
+					sql += L", ";
+				sql += sqlValues;
+			}
+
+			return sql;
+		};
+
+		const auto& sqlFullBatch = makeSql(SAVE_SNAPSHOT_BATCH_SIZE);
+
+		for (size_t batchStart = 0; batchStart < rowCount; batchStart += SAVE_SNAPSHOT_BATCH_SIZE)
+		{
+			const size_t batchSize = std::min<size_t>(SAVE_SNAPSHOT_BATCH_SIZE, rowCount - batchStart);
+
+			auto cmd = db.prepare(SAVE_SNAPSHOT_BATCH_SIZE == batchSize ? sqlFullBatch : makeSql(batchSize));
+
+			for (size_t i = batchStart; i < batchStart + batchSize; ++i)
+				addRowParameters(cmd, i);
+
+			cmd.execute();
+
+			if (onBatch)
+				onBatch(batchStart + batchSize);
+		}
+	}
+}
 
 DirectoryStore::DirectoryStore()
+	: m_memoryBudget(readMemoryBudget())
+	, m_mimeDetailsMinSize(readMimeDetailsMinSize())
 {
 	checkCreateDbSchema();
 }
@@ -22,6 +113,70 @@ DirectoryStore::instance()
 	return &s_instance;
 }
 
+size_t
+DirectoryStore::readMemoryBudget()
+{
+	// Megabytes of mime details kept in memory, 0 (default) for no limit
+	bool ok = false;
+	unsigned budgetMb = Settings::instance()->value(STORE_MEMORY_BUDGET_NAME, 0).toUInt(&ok);
+
+	return ok ? static_cast<size_t>(budgetMb) * 1024 * 1024 : 0;
+}
+
+size_t
+DirectoryStore::readMimeDetailsMinSize()
+{
+	// Megabytes, 0 to save mime details of all directories
+	bool ok = false;
+	unsigned minSizeMb = Settings::instance()->value(STORE_MIME_DETAILS_MIN_SIZE_NAME, 1).toUInt(&ok);
+
+	return ok ? static_cast<size_t>(minSizeMb) * 1024 * 1024 : 0;
+}
+
+PackedDirectory*
+DirectoryStore::Shard::find(TPathId pathId)
+{
+	const size_t slot = pathId / STORE_SHARD_COUNT;
+	if (slot >= directories.size() || !directories[slot].isPresent())
+		return nullptr;
+
+	return &directories[slot];
+}
+
+const PackedDirectory*
+DirectoryStore::Shard::find(TPathId pathId) const
+{
+	return const_cast<Shard*>(this)->find(pathId);
+}
+
+PackedDirectory&
+DirectoryStore::Shard::findOrAdd(TPathId pathId)
+{
+	const size_t slot = pathId / STORE_SHARD_COUNT;
+	if (slot >= directories.size())
+		directories.resize(slot + 1);
+
+	auto& packedDir = directories[slot];
+	if (!packedDir.isPresent())
+	{
+		packedDir.flags = PackedDirectory::Present;
+		++directoryCount;
+	}
+
+	return packedDir;
+}
+
+void
+DirectoryStore::Shard::erase(TPathId pathId)
+{
+	auto pPackedDir = find(pathId);
+	if (nullptr == pPackedDir)
+		return;
+
+	*pPackedDir = PackedDirectory{};
+	--directoryCount;
+}
+
 void
 DirectoryStore::upsertDirectory(
 	const QString& unifiedPath,
@@ -35,25 +190,34 @@ DirectoryStore::upsertDirectory(
 
 	assert(isUnifiedPath(unifiedPath));
 
-	std::scoped_lock lock_(m_sync);
+	upsertDirectory(PathTable::instance()->intern(unifiedPath), dirDetails, updateDirectoryStats);
+}
+
+void
+DirectoryStore::upsertDirectory(
+	TPathId pathId,
+	const DirectoryDetails& dirDetails,
+	bool updateDirectoryStats)
+{
+	assert(InvalidPathId != pathId);
 
-	auto iter = m_directories.find(unifiedPath);
-	if (iter == m_directories.end())
 	{
-		auto tup = m_directories.emplace(std::make_pair(unifiedPath, DirectoryDetails{
-			{ .status = DirectoryProcessingStatus::Pending } }));
-		assert(tup.second);
-		iter = tup.first;
-	}
+		auto& shard_ = shard(pathId);
+		std::scoped_lock lock_(shard_.sync);
+
+		auto& packedDir = shard_.findOrAdd(pathId);
+		packedDir.setStatus(dirDetails.status);
+
+		if (updateDirectoryStats)
+			packedDir.assignStats(dirDetails);
 
-	DirectoryDetails &existingDirDetails = iter->second;
-	existingDirDetails.status = dirDetails.status;
+		if (nullptr == dirDetails.mimeDetailsList)
+			return;
 
-	if (updateDirectoryStats)
-		existingDirDetails.DirectoryStats::assignStats(dirDetails);
+		assignMimeDetails(shard_, pathId, packedDir, dirDetails.mimeDetailsList);
+	}
 
-	if (dirDetails.mimeDetailsList.has_value())
-		existingDirDetails.mimeDetailsList = dirDetails.mimeDetailsList;
+	enforceMemoryBudget();
 }
 
 bool
@@ -64,181 +228,2049 @@ DirectoryStore::tryGetDirectory(
 {
 	assert(isUnifiedPath(unifiedPath));
 
-	std::scoped_lock lock_(m_sync);
-
-	const auto iter = m_directories.find(unifiedPath);
-	if (iter == m_directories.end())
+	// Never scanned paths are not interned
+	TPathId pathId = PathTable::instance()->find(unifiedPath);
+	if (InvalidPathId == pathId)
 		return false;
 
-	const auto& dirDetails = iter->second;
-	bool ready = dirDetails.status == DirectoryProcessingStatus::Ready;
-
-	directoryDetails = dirDetails.clone(ready || !fillinMimeSizesOnlyIfReady);
-	return true;
+	return tryGetDirectory(pathId, fillinMimeSizesOnlyIfReady, directoryDetails);
 }
 
-std::wstring
-DirectoryStore::getDbFileName() const
+bool
+DirectoryStore::tryGetDirectory(
+	TPathId pathId,
+	bool fillinMimeSizesOnlyIfReady,
+	DirectoryDetails& directoryDetails)
 {
-	const auto& dbFileName = Settings::instance()->dbFileName();
-	return dbFileName;
+	{
+		auto& shard_ = shard(pathId);
+		std::scoped_lock lock_(shard_.sync);
+
+		const auto pPackedDir = shard_.find(pathId);
+		if (nullptr == pPackedDir)
+			return false;
+
+		bool ready = pPackedDir->getStatus() == DirectoryProcessingStatus::Ready;
+		bool fillinMimeSizes = ready || !fillinMimeSizesOnlyIfReady;
+
+		directoryDetails = pPackedDir->unpack(fillinMimeSizes);
+
+		if (!fillinMimeSizes)
+			return true;
+
+		pPackedDir->flags |= PackedDirectory::Referenced;
+
+		if (0 == (pPackedDir->flags & PackedDirectory::Spilled))
+			return true;
+
+		directoryDetails.mimeDetailsList = faultInMimeDetails(shard_, pathId, *pPackedDir);
+	}
+
+	enforceMemoryBudget();
+	return true;
 }
 
 void
-DirectoryStore::checkCreateDbSchema()
+DirectoryStore::assignMimeDetails(
+	Shard& shard_,
+	TPathId pathId,
+	PackedDirectory& packedDir,
+	TMimeDetailsListPtr pMimeDetails,
+	bool keepPersisted)
 {
-	const auto& dbFileName = getDbFileName();
-	SqliteDb db(dbFileName);
+	// Mime details are saved only for big enough directories
+	if (!keepPersisted &&
+		0 != (packedDir.flags & PackedDirectory::Persisted) &&
+		packedDir.stats().totalSize.value_or(0) >= m_mimeDetailsMinSize &&
+		!hasSameMimeDetails(shard_, pathId, packedDir, pMimeDetails))
+	{
+		packedDir.flags &= ~PackedDirectory::Persisted;
+	}
 
-	const auto sqlCheckTable = L"SELECT COUNT(*) FROM sqlite_master WHERE type='table' AND name=?";
+	if (nullptr != packedDir.mimeDetailsList)
+		m_mimeBytes -= packedDir.mimeDetailsList->memoryUsage();
 
-	// snapshots table
-	auto rs1 = db
-		.prepare(sqlCheckTable)
-		.addParameter(SQL_TABLE_SNAPSHOTS)
-		.select();
+	// New details are not spilled before the next sweep
+	if (nullptr != pMimeDetails)
+	{
+		m_mimeBytes += pMimeDetails->memoryUsage();
+		packedDir.flags |= PackedDirectory::Referenced;
+	}
 
-	int rowCount = rs1.getInt(0).value();
-	if (0 == rowCount)
+	if (0 != (packedDir.flags & PackedDirectory::Spilled))
 	{
-		db.execute(L"CREATE TABLE " SQL_TABLE_SNAPSHOTS L" (\n"
-			L"id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
-			L"date_time TEXT NOT NULL\n"
-			L")");
+		packedDir.flags &= ~PackedDirectory::Spilled;
+
+		const auto iter = shard_.spillOffsets.find(pathId);
+		m_pSpillFile->release(iter->second);
+		shard_.spillOffsets.erase(iter);
 	}
 
-	// directories table
-	auto rs2 = db
-		.prepare(sqlCheckTable)
-		.addParameter(SQL_TABLE_DIRECTORIES)
-		.select();
+	packedDir.mimeDetailsList = std::move(pMimeDetails);
+}
 
-	rowCount = rs2.getInt(0).value();
-	if (0 == rowCount)
+bool
+DirectoryStore::hasSameMimeDetails(
+	const Shard& shard_,
+	TPathId pathId,
+	const PackedDirectory& packedDir,
+	const TMimeDetailsListPtr& pMimeDetails) const
+{
+	auto pCurrentMimeDetails = packedDir.mimeDetailsList;
+	if (0 != (packedDir.flags & PackedDirectory::Spilled))
+		pCurrentMimeDetails = readSpilledMimeDetails(shard_.spillOffsets.at(pathId));
+
+	if (pCurrentMimeDetails == pMimeDetails)
+		return true;
+
+	return nullptr != pCurrentMimeDetails && nullptr != pMimeDetails &&
+		*pCurrentMimeDetails == *pMimeDetails;
+}
+
+TMimeDetailsListPtr
+DirectoryStore::readSpilledMimeDetails(uint64_t spillOffset) const
+{
+	try
 	{
-		db.execute(L"CREATE TABLE " SQL_TABLE_DIRECTORIES L" (\n"
-			L"id INTEGER PRIMARY KEY,\n"
-			L"snapshot_id INTEGER NOT NULL,\n"
-			L"path TEXT NOT NULL,\n"
-			L"total_file_count INTEGER NOT NULL,\n"
-			L"total_size INTEGER NOT NULL,\n"
-			L"subdir_count INTEGER NOT NULL,\n"
-			L"FOREIGN KEY (snapshot_id) REFERENCES " SQL_TABLE_SNAPSHOTS L"(id)\n"
-			L")");
+		return std::make_shared<const TMimeDetailsList>(m_pSpillFile->read(spillOffset));
+	}
+	catch (const std::exception& x)
+	{
+		qCritical() << "ERROR: " << x.what() << endl;
+		return nullptr;
 	}
 }
 
-bool
-DirectoryStore::hasData() const
+TMimeDetailsListPtr
+DirectoryStore::faultInMimeDetails(Shard& shard_, TPathId pathId, PackedDirectory& packedDir)
 {
-	std::scoped_lock lock_(m_sync);
-	bool res = !m_directories.empty();
-	return res;
+	auto pMimeDetails = readSpilledMimeDetails(shard_.spillOffsets.at(pathId));
+	if (nullptr != pMimeDetails)
+		assignMimeDetails(shard_, pathId, packedDir, pMimeDetails, true);
+
+	return pMimeDetails;
 }
 
 void
-DirectoryStore::saveCurrentData()
+DirectoryStore::enforceMemoryBudget()
 {
-	std::scoped_lock lock_(m_sync);
+	const size_t memoryBudget = m_memoryBudget;
+	if (0 == memoryBudget || m_mimeBytes <= memoryBudget)
+		return;
 
-	const auto& dbFileName = getDbFileName();
-	SqliteDb db(dbFileName);
-	auto transaction = db.beginTransaction();
+	// Somebody is spilling already
+	std::unique_lock lock_(m_syncSpill, std::try_to_lock);
+	if (!lock_.owns_lock())
+		return;
 
-	try
+	if (nullptr == m_pSpillFile)
 	{
-		// Create new snapshot
-		db.prepare(L"INSERT INTO " SQL_TABLE_SNAPSHOTS L" (date_time) VALUES (?); ")
-			.addParameter(std::chrono::utc_clock::now())
-			.execute();
+		try
+		{
+			auto spillFileName = std::filesystem::path(getDbFileName());
+			spillFileName.replace_extension(L".spill");
 
-		// Get snapshot id
-		auto rs = db.select(L"SELECT MAX(last_insert_rowid()) FROM " SQL_TABLE_SNAPSHOTS);
-		const int snapshotId = rs.getInt(0).value();
+			m_pSpillFile = std::make_unique<MimeSpillFile>(spillFileName);
+		}
+		catch (const std::exception& x)
+		{
+			qCritical() << "ERROR: " << x.what() << ", memory budget is disabled" << endl;
+			m_memoryBudget = 0;
+			return;
+		}
+	}
 
-		const auto sqlInsertDir =
-			L"INSERT INTO " SQL_TABLE_DIRECTORIES L" (snapshot_id, path, total_file_count, total_size, subdir_count) "
-			L"VALUES (?, ?, ?, ?, ?)";
+	const size_t targetBytes = memoryBudget / 100 * SPILL_TARGET_PERCENT;
 
-		// Add directory data
-		for (auto iter = m_directories.cbegin(); iter != m_directories.cend(); ++iter)
+	// Clock sweep over the shards. A directory read since the previous pass gets
+	//	a second chance, so two rounds visit each directory as a victim candidate.
+	for (size_t step = 0; step < 2 * STORE_SHARD_COUNT && m_mimeBytes > targetBytes; ++step)
+	{
+		const size_t shardIndex = m_spillShardIndex;
+		m_spillShardIndex = (m_spillShardIndex + 1) % STORE_SHARD_COUNT;
+
+		auto& shard_ = m_shards[shardIndex];
+
+		std::vector<std::pair<TPathId, TMimeDetailsList>> listingVictims;
+		std::vector<std::pair<TPathId, TMimeDetailsListPtr>> victims;
 		{
-			const auto& unifiedPath = iter->first;
-			const auto& dirDetails = iter->second;
+			std::scoped_lock lockShard_(shard_.sync);
 
-			if (!dirDetails.mimeDetailsList.has_value())
-				continue;
+			size_t victimBytes = 0;
 
-			// Get details
-			auto mimeDetailsList = dirDetails.mimeDetailsList.value();
-			auto mimeDetails = mimeDetailsList[TMimeDetailsList::ALL_MIMETYPE];
+			// Listings are read on rescan only, so they are always cold
+			for (const auto& pairListing : shard_.listings)
+			{
+				if (m_mimeBytes <= targetBytes + victimBytes)
+					break;
 
-			auto cmd = std::move(db.prepare(sqlInsertDir)
-				.addParameter(snapshotId)
-				.addParameter(unifiedPath.toStdWString()));
+				// Spilled ones keep just the (empty) ALL_MIMETYPE item
+				const auto& ownMimeSizes = pairListing.second.ownMimeSizes;
+				if (ownMimeSizes.size() <= 1 || shard_.listingSpillOffsets.contains(pairListing.first))
+					continue;
 
-			if (dirDetails.totalFileCount.has_value())
-				cmd.addParameter(static_cast<long long>(dirDetails.totalFileCount.value()));
-			else
-				cmd.addParameterNull();
+				victimBytes += listingMimeBytes(pairListing.second);
+				listingVictims.emplace_back(pairListing.first, ownMimeSizes);
+			}
 
-			if (dirDetails.totalSize.has_value())
-				cmd.addParameter(static_cast<long long>(dirDetails.totalSize.value()));
-			else
-				cmd.addParameterNull();
+			for (size_t slot = 0; slot < shard_.directories.size() && m_mimeBytes > targetBytes + victimBytes; ++slot)
+			{
+				auto& packedDir = shard_.directories[slot];
+				if (nullptr == packedDir.mimeDetailsList)
+					continue;
 
-			if (dirDetails.subdirectoryCount.has_value())
-				cmd.addParameter(static_cast<long long>(dirDetails.subdirectoryCount.value()));
-			else
-				cmd.addParameterNull();
+				if (0 != (packedDir.flags & PackedDirectory::Referenced))
+				{
+					packedDir.flags &= ~PackedDirectory::Referenced;
+					continue;
+				}
 
-			cmd.execute();
+				// Being read or updated by somebody
+				if (1 != packedDir.mimeDetailsList.use_count())
+					continue;
+
+				victimBytes += packedDir.mimeDetailsList->memoryUsage();
+				victims.emplace_back(static_cast<TPathId>(slot * STORE_SHARD_COUNT + shardIndex), packedDir.mimeDetailsList);
+			}
 		}
 
-		transaction.commit();
+		if (listingVictims.empty() && victims.empty())
+			continue;
+
+		// Written without the shard lock
+		std::vector<uint64_t> listingSpillOffsets;
+		listingSpillOffsets.reserve(listingVictims.size());
+		std::vector<uint64_t> spillOffsets;
+		spillOffsets.reserve(victims.size());
+		try
+		{
+			for (const auto& victim : listingVictims)
+				listingSpillOffsets.push_back(m_pSpillFile->write(victim.second));
+
+			for (const auto& victim : victims)
+				spillOffsets.push_back(m_pSpillFile->write(*victim.second));
+		}
+		catch (const std::exception& x)
+		{
+			qCritical() << "ERROR: " << x.what() << ", memory budget is disabled" << endl;
+			m_memoryBudget = 0;
+			listingVictims.resize(listingSpillOffsets.size());
+			victims.resize(spillOffsets.size());
+		}
+
+		{
+			std::scoped_lock lockShard_(shard_.sync);
+
+			for (size_t i = 0; i < listingVictims.size(); ++i)
+			{
+				const TPathId pathId = listingVictims[i].first;
+
+				// Skip the ones updated in between
+				const auto iter = shard_.listings.find(pathId);
+				if (iter == shard_.listings.end() ||
+					shard_.listingSpillOffsets.contains(pathId) ||
+					!(iter->second.ownMimeSizes == listingVictims[i].second))
+				{
+					m_pSpillFile->release(listingSpillOffsets[i]);
+					continue;
+				}
+
+				m_mimeBytes -= listingMimeBytes(iter->second);
+				iter->second.ownMimeSizes = TMimeDetailsList();
+				m_mimeBytes += listingMimeBytes(iter->second);
+
+				shard_.listingSpillOffsets[pathId] = listingSpillOffsets[i];
+			}
+
+			for (size_t i = 0; i < victims.size(); ++i)
+			{
+				const TPathId pathId = victims[i].first;
+
+				// Skip the ones updated in between
+				auto pPackedDir = shard_.find(pathId);
+				if (nullptr == pPackedDir || pPackedDir->mimeDetailsList != victims[i].second)
+				{
+					m_pSpillFile->release(spillOffsets[i]);
+					continue;
+				}
+
+				m_mimeBytes -= pPackedDir->mimeDetailsList->memoryUsage();
+				pPackedDir->mimeDetailsList.reset();
+				pPackedDir->flags |= PackedDirectory::Spilled;
+
+				shard_.spillOffsets[pathId] = spillOffsets[i];
+			}
+		}
+
+		if (0 == m_memoryBudget)
+			break;
 	}
-	catch (...)
+}
+
+size_t
+DirectoryStore::listingMimeBytes(const DirectoryListing& listing)
+{
+	// The list itself is a part of the listing
+	return listing.ownMimeSizes.memoryUsage() - sizeof(listing.ownMimeSizes);
+}
+
+void
+DirectoryStore::assignListing(Shard& shard_, TPathId pathId, DirectoryListing&& listing)
+{
+	eraseListing(shard_, pathId);
+
+	m_mimeBytes += listingMimeBytes(listing);
+	shard_.listings.emplace(pathId, std::move(listing));
+}
+
+void
+DirectoryStore::eraseListing(Shard& shard_, TPathId pathId)
+{
+	const auto iter = shard_.listings.find(pathId);
+	if (iter == shard_.listings.end())
+		return;
+
+	m_mimeBytes -= listingMimeBytes(iter->second);
+	shard_.listings.erase(iter);
+
+	const auto iterSpilled = shard_.listingSpillOffsets.find(pathId);
+	if (iterSpilled != shard_.listingSpillOffsets.end())
 	{
-		transaction.rollback();
-		throw;
+		m_pSpillFile->release(iterSpilled->second);
+		shard_.listingSpillOffsets.erase(iterSpilled);
 	}
 }
 
-DirectoryStore::TDirectoryStatsHistory
-DirectoryStore::getDirectoryStatsHistory(const QString& unifiedPath) const
+void
+DirectoryStore::upsertDirectoryListing(TPathId pathId, DirectoryListing&& listing)
 {
-	std::scoped_lock lock_(m_sync);
+	assert(InvalidPathId != pathId);
 
-	const auto& dbFileName = getDbFileName();
-	SqliteDb db(dbFileName);
+	{
+		auto& shard_ = shard(pathId);
+		std::scoped_lock lock_(shard_.sync);
+		assignListing(shard_, pathId, std::move(listing));
+	}
 
-	const auto sqlQuery =
-		L"SELECT s.date_time, d.total_file_count, d.total_size, d.subdir_count \nFROM "
-		SQL_TABLE_DIRECTORIES L" d\n"
-		L"JOIN " SQL_TABLE_SNAPSHOTS L" s\n"
-		L"ON d.snapshot_id = s.id \n"
-		L"WHERE d.path = ?\n"
-		L"ORDER BY s.date_time";
+	enforceMemoryBudget();
+}
 
-	TDirectoryStatsHistory history;
+bool
+DirectoryStore::tryGetDirectoryListing(TPathId pathId, DirectoryListing& listing) const
+{
+	const auto& shard_ = shard(pathId);
+	std::scoped_lock lock_(shard_.sync);
 
-	auto stdUnifiedPath = unifiedPath.toStdWString();
-	auto rs = db.prepare(sqlQuery)
-				.addParameter(stdUnifiedPath)
-				.select();
+	const auto iter = shard_.listings.find(pathId);
+	if (iter == shard_.listings.end())
+		return false;
 
-	for (; !!rs; ++rs)
+	listing = iter->second;
+
+	const auto iterSpilled = shard_.listingSpillOffsets.find(pathId);
+	if (iterSpilled == shard_.listingSpillOffsets.end())
+		return true;
+
+	// Without own mime sizes the listing is of no use
+	const auto pOwnMimeSizes = readSpilledMimeDetails(iterSpilled->second);
+	if (nullptr == pOwnMimeSizes)
+		return false;
+
+	listing.ownMimeSizes = *pOwnMimeSizes;
+	return true;
+}
+
+bool
+DirectoryStore::tryGetOwnStats(TPathId pathId, DirectoryStats& ownStats) const
+{
+	const auto& shard_ = shard(pathId);
+	std::scoped_lock lock_(shard_.sync);
+
+	const auto iter = shard_.listings.find(pathId);
+	if (iter == shard_.listings.end())
+		return false;
+
+	ownStats.assignStats(iter->second.ownStats);
+	return true;
+}
+
+void
+DirectoryStore::invalidateScanResults(const TInvalidatedCallback& onInvalidated)
+{
+	std::vector<TPathId> invalidated;
+
+	// Stats are kept to be displayed until the directory is scanned again
+	for (size_t shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex)
 	{
-		auto dt = rs.getDateTime(0);
-		assert(dt.has_value());
+		invalidated.clear();
+		{
+			auto& shard_ = m_shards[shardIndex];
+			std::scoped_lock lock_(shard_.sync);
 
-		DirectoryStats dirStats;
-		dirStats.totalFileCount = rs.getInt64(1);
-		dirStats.totalSize = rs.getInt64(2);
-		dirStats.subdirectoryCount = rs.getInt64(3);
+			auto& directories = shard_.directories;
+			for (size_t slot = 0; slot < directories.size(); ++slot)
+			{
+				auto& packedDir = directories[slot];
+				if (!packedDir.isPresent())
+					continue;
 
-		history.emplace(std::make_pair(dt.value(), dirStats));
+				if (DirectoryProcessingStatus::Ready == packedDir.getStatus())
+					packedDir.setStatus(DirectoryProcessingStatus::Stale);
+				else if (DirectoryProcessingStatus::Error == packedDir.getStatus())
+					packedDir.setStatus(DirectoryProcessingStatus::Pending);
+				else
+					continue;
+
+				invalidated.push_back(static_cast<TPathId>(slot * STORE_SHARD_COUNT + shardIndex));
+			}
+		}
+
+		if (!invalidated.empty())
+			onInvalidated(invalidated);
 	}
+}
 
-	return history;
+std::vector<TPathId>
+DirectoryStore::collectListedSubtree(TPathId pathId) const
+{
+	std::vector<TPathId> subtree{ pathId };
+
+	// Breadth-first, the subtree vector itself is the queue
+	for (size_t i = 0; i < subtree.size(); ++i)
+	{
+		const auto& shard_ = shard(subtree[i]);
+		std::scoped_lock lock_(shard_.sync);
+
+		const auto iter = shard_.listings.find(subtree[i]);
+		if (iter != shard_.listings.end())
+		{
+			const auto& subdirectories = iter->second.subdirectories;
+			subtree.insert(subtree.end(), subdirectories.cbegin(), subdirectories.cend());
+		}
+	}
+
+	return subtree;
+}
+
+std::vector<TPathId>
+DirectoryStore::getListedSubtree(TPathId pathId) const
+{
+	return collectListedSubtree(pathId);
+}
+
+bool
+DirectoryStore::adjustReadyDirectory(
+	TPathId pathId,
+	const DirectoryStats& removedStats,
+	const TMimeDetailsList& removedMimeSizes,
+	const DirectoryStats& addedStats,
+	const TMimeDetailsList& addedMimeSizes,
+	DirectoryDetails& dirDetails)
+{
+	auto& shard_ = shard(pathId);
+	std::scoped_lock lock_(shard_.sync);
+
+	auto pPackedDir = shard_.find(pathId);
+	if (nullptr == pPackedDir ||
+		DirectoryProcessingStatus::Ready != pPackedDir->getStatus())
+	{
+		return false;
+	}
+
+	auto stats = pPackedDir->stats();
+	stats.subtractStats(removedStats);
+	stats.addStats(addedStats);
+	pPackedDir->assignStats(stats);
+
+	auto pCurrentMimeSizes = pPackedDir->mimeDetailsList;
+	if (0 != (pPackedDir->flags & PackedDirectory::Spilled))
+		pCurrentMimeSizes = readSpilledMimeDetails(shard_.spillOffsets.at(pathId));
+
+	if (nullptr != pCurrentMimeSizes)
+	{
+		// Readers may hold the current list, so it is replaced rather than modified
+		auto pMimeSizes = std::make_shared<TMimeDetailsList>(*pCurrentMimeSizes);
+		pMimeSizes->subtractMimeDetails(removedMimeSizes);
+		pMimeSizes->addMimeDetails(addedMimeSizes);
+
+		assignMimeDetails(shard_, pathId, *pPackedDir, std::move(pMimeSizes));
+	}
+
+	dirDetails = pPackedDir->unpack(true);
+	return true;
+}
+
+bool
+DirectoryStore::markStale(TPathId pathId)
+{
+	auto& shard_ = shard(pathId);
+	std::scoped_lock lock_(shard_.sync);
+
+	auto pPackedDir = shard_.find(pathId);
+	if (nullptr == pPackedDir ||
+		DirectoryProcessingStatus::Ready != pPackedDir->getStatus())
+	{
+		return false;
+	}
+
+	pPackedDir->setStatus(DirectoryProcessingStatus::Stale);
+	return true;
+}
+
+std::vector<TPathId>
+DirectoryStore::markSubtreeStale(TPathId pathId)
+{
+	std::vector<TPathId> marked;
+	for (auto id : collectListedSubtree(pathId))
+	{
+		auto& shard_ = shard(id);
+		std::scoped_lock lock_(shard_.sync);
+
+		auto pPackedDir = shard_.find(id);
+		if (nullptr != pPackedDir &&
+			DirectoryProcessingStatus::Ready == pPackedDir->getStatus())
+		{
+			pPackedDir->setStatus(DirectoryProcessingStatus::Stale);
+			marked.push_back(id);
+		}
+	}
+
+	return marked;
+}
+
+void
+DirectoryStore::removeDirectorySubtree(TPathId pathId)
+{
+	auto pPathTable = PathTable::instance();
+
+	// Interned subtree, since directories loaded from a snapshot have no listings
+	std::vector<TPathId> subtree{ pathId };
+	for (size_t i = 0; i < subtree.size(); ++i)
+	{
+		const auto& children = pPathTable->children(subtree[i]);
+		subtree.insert(subtree.end(), children.cbegin(), children.cend());
+	}
+
+	for (auto id : subtree)
+	{
+		auto& shard_ = shard(id);
+		std::scoped_lock lock_(shard_.sync);
+
+		auto pPackedDir = shard_.find(id);
+		if (nullptr != pPackedDir)
+		{
+			if (0 != (pPackedDir->flags & PackedDirectory::Persisted))
+				shard_.removedPersisted.push_back(id);
+
+			assignMimeDetails(shard_, id, *pPackedDir, nullptr, true);
+		}
+
+		shard_.erase(id);
+		eraseListing(shard_, id);
+	}
+}
+
+std::wstring
+DirectoryStore::getDbFileName() const
+{
+	const auto& dbFileName = Settings::instance()->dbFileName();
+	return dbFileName;
+}
+
+void
+DirectoryStore::checkCreateDbSchema()
+{
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	// Readers (e.g. history) are not blocked by a snapshot being saved. The mode is persistent.
+	db.execute(L"PRAGMA journal_mode=WAL");
+
+	const auto sqlCheckTable = L"SELECT COUNT(*) FROM sqlite_master WHERE type='table' AND name=?";
+
+	// snapshots table
+	auto rs1 = db
+		.prepare(sqlCheckTable)
+		.addParameter(SQL_TABLE_SNAPSHOTS)
+		.select();
+
+	int rowCount = rs1.getInt(0).value();
+	if (0 == rowCount)
+	{
+		db.execute(L"CREATE TABLE " SQL_TABLE_SNAPSHOTS L" (\n"
+			L"id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+			L"date_time TEXT NOT NULL\n"
+			L")");
+	}
+
+	// paths table, a path component per row. Roots have parent_id 0.
+	auto rs2 = db
+		.prepare(sqlCheckTable)
+		.addParameter(SQL_TABLE_PATHS)
+		.select();
+
+	rowCount = rs2.getInt(0).value();
+	if (0 == rowCount)
+	{
+		db.execute(L"CREATE TABLE " SQL_TABLE_PATHS L" (\n"
+			L"id INTEGER PRIMARY KEY,\n"
+			L"parent_id INTEGER NOT NULL,\n"
+			L"name TEXT NOT NULL,\n"
+			L"UNIQUE (parent_id, name)\n"
+			L")");
+	}
+
+	// extensions table, the dictionary of mime details
+	auto rsExtensions = db
+		.prepare(sqlCheckTable)
+		.addParameter(SQL_TABLE_EXTENSIONS)
+		.select();
+
+	if (0 == rsExtensions.getInt(0).value())
+	{
+		db.execute(L"CREATE TABLE " SQL_TABLE_EXTENSIONS L" (\n"
+			L"id INTEGER PRIMARY KEY,\n"
+			L"name TEXT NOT NULL UNIQUE\n"
+			L")");
+	}
+
+	// mime_details table, an extension of a directories row per row
+	auto rsMimeDetails = db
+		.prepare(sqlCheckTable)
+		.addParameter(SQL_TABLE_MIME_DETAILS)
+		.select();
+
+	if (0 == rsMimeDetails.getInt(0).value())
+	{
+		db.execute(L"CREATE TABLE " SQL_TABLE_MIME_DETAILS L" (\n"
+			L"path_id INTEGER NOT NULL,\n"
+			L"snapshot_id INTEGER NOT NULL,\n"
+			L"extension_id INTEGER NOT NULL,\n"
+			L"file_count INTEGER NOT NULL,\n"
+			L"total_size INTEGER NOT NULL,\n"
+			L"PRIMARY KEY (path_id, snapshot_id, extension_id),\n"
+			L"FOREIGN KEY (extension_id) REFERENCES " SQL_TABLE_EXTENSIONS L"(id)\n"
+			L") WITHOUT ROWID");
+	}
+
+	// directories table
+	auto rs3 = db
+		.prepare(sqlCheckTable)
+		.addParameter(SQL_TABLE_DIRECTORIES)
+		.select();
+
+	rowCount = rs3.getInt(0).value();
+	if (0 == rowCount)
+		db.execute(SQL_CREATE_TABLE_DIRECTORIES);
+	else
+		upgradeDirectoriesTable(db);
+
+	// Rows saved by a range of snapshots (deltas between snapshots)
+	db.execute(L"CREATE INDEX IF NOT EXISTS ix_directories_snapshot ON " SQL_TABLE_DIRECTORIES L" (snapshot_id)");
+}
+
+void
+DirectoryStore::upgradeDirectoriesTable(SqliteDb& db)
+{
+	const auto sqlCheckColumn = L"SELECT COUNT(*) FROM pragma_table_info(?) WHERE name=?";
+
+	// Databases with full snapshots only, which are valid deltas as well
+	auto rs4 = db
+		.prepare(sqlCheckColumn)
+		.addParameter(SQL_TABLE_DIRECTORIES)
+		.addParameter(L"removed")
+		.select();
+
+	if (0 == rs4.getInt(0).value())
+		db.execute(L"ALTER TABLE " SQL_TABLE_DIRECTORIES L" ADD COLUMN removed INTEGER NOT NULL DEFAULT 0");
+
+	// Databases with path text in each row
+	auto rs5 = db
+		.prepare(sqlCheckColumn)
+		.addParameter(SQL_TABLE_DIRECTORIES)
+		.addParameter(L"path")
+		.select();
+
+	// Takes a while, so it is not done here (see upgradeDatabase())
+	if (0 != rs5.getInt(0).value())
+		m_pathIdsMigrationNeeded = true;
+}
+
+bool
+DirectoryStore::isUpgradeNeeded() const
+{
+	std::scoped_lock lock_(m_syncUpgrade);
+	return m_pathIdsMigrationNeeded;
+}
+
+void
+DirectoryStore::upgradeDatabase(const TProgressCallback& onProgress) const
+{
+	std::scoped_lock lock_(m_syncUpgrade);
+
+	if (!m_pathIdsMigrationNeeded)
+		return;
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	migrateDirectoriesToPathIds(db, onProgress);
+	m_pathIdsMigrationNeeded = false;
+}
+
+void
+DirectoryStore::migrateDirectoriesToPathIds(SqliteDb& db, const TProgressCallback& onProgress) const
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	auto pPathTable = PathTable::instance();
+
+	TDbPathIds resolved;
+	size_t pathCount = 0;
+
+	auto transaction = db.beginTransaction();
+
+	try
+	{
+		db.execute(L"ALTER TABLE " SQL_TABLE_DIRECTORIES L" RENAME TO directories_v1");
+		db.execute(SQL_CREATE_TABLE_DIRECTORIES);
+
+		std::vector<std::wstring> paths;
+		{
+			auto rs = db.select(L"SELECT DISTINCT path FROM directories_v1 WHERE path <> ''");
+			for (; !!rs; ++rs)
+				paths.push_back(rs.getString(0).value());
+		}
+
+		// Paths saved already (if any), parents go before their children
+		long long lastDbPathId = 0;
+		{
+			std::unordered_map<long long, TPathId> savedPathIds;
+
+			auto rs = db.select(L"SELECT id, parent_id, name FROM " SQL_TABLE_PATHS L" ORDER BY id");
+			for (; !!rs; ++rs)
+			{
+				const long long dbPathId = rs.getInt64(0).value();
+				const auto& name = QString::fromStdWString(rs.getString(2).value());
+
+				const auto iter = savedPathIds.find(rs.getInt64(1).value());
+				const TPathId pathId = savedPathIds.end() == iter ?
+					pPathTable->intern(name) : pPathTable->internChild(iter->second, name);
+
+				savedPathIds.emplace(dbPathId, pathId);
+				resolved.emplace(pathId, dbPathId);
+				lastDbPathId = dbPathId;
+			}
+		}
+
+		// IDs of missing path components are assigned here rather than looked up one by one.
+		//	Paths are split into components the same way they are interned.
+		struct PathRow
+		{
+			long long dbPathId;
+			long long parentDbPathId;
+			std::wstring name;
+		};
+
+		std::vector<PathRow> pathRows;
+		std::vector<long long> dbPathIds;
+		dbPathIds.reserve(paths.size());
+
+		for (const auto& path : paths)
+		{
+			// Components not known yet, the deepest first
+			std::vector<TPathId> unknownIds;
+			long long dbPathId = 0;
+
+			for (TPathId id = pPathTable->intern(QString::fromStdWString(path)); InvalidPathId != id; id = pPathTable->parent(id))
+			{
+				const auto iter = resolved.find(id);
+				if (resolved.end() != iter)
+				{
+					dbPathId = iter->second;
+					break;
+				}
+
+				unknownIds.push_back(id);
+			}
+
+			for (auto iter = unknownIds.crbegin(); iter != unknownIds.crend(); ++iter)
+			{
+				pathRows.push_back(PathRow{ ++lastDbPathId, dbPathId, pPathTable->name(*iter).toStdWString() });
+				dbPathId = lastDbPathId;
+				resolved.emplace(*iter, dbPathId);
+			}
+
+			dbPathIds.push_back(dbPathId);
+		}
+
+		// Inserted rows make up the first 90%, the copy of directories the rest
+		const size_t totalRowCount = pathRows.size() + paths.size();
+		const auto reportProgress = [&](size_t rowCount) {
+			if (onProgress && 0 != totalRowCount)
+				onProgress(static_cast<int>(rowCount * 90 / totalRowCount));
+		};
+
+		insertBatched(
+			db,
+			L"INSERT INTO " SQL_TABLE_PATHS L" (id, parent_id, name)",
+			L"(?, ?, ?)",
+			pathRows.size(),
+			[&](auto& cmd, size_t i) {
+				const auto& pathRow = pathRows[i];
+				cmd.addParameter(pathRow.dbPathId)
+					.addParameter(pathRow.parentDbPathId)
+					.addParameter(pathRow.name);
+			},
+			reportProgress);
+
+		db.execute(L"CREATE TEMP TABLE path_map (path TEXT PRIMARY KEY, path_id INTEGER NOT NULL)");
+
+		insertBatched(
+			db,
+			L"INSERT INTO path_map (path, path_id)",
+			L"(?, ?)",
+			paths.size(),
+			[&](auto& cmd, size_t i) {
+				cmd.addParameter(paths[i])
+					.addParameter(dbPathIds[i]);
+			},
+			[&](size_t rowCount) {
+				reportProgress(pathRows.size() + rowCount);
+			});
+
+		db.execute(L"INSERT INTO " SQL_TABLE_DIRECTORIES L" (path_id, snapshot_id, total_file_count, total_size, subdir_count, removed)\n"
+			L"SELECT m.path_id, o.snapshot_id, o.total_file_count, o.total_size, o.subdir_count, o.removed\n"
+			L"FROM directories_v1 o\n"
+			L"JOIN path_map m ON m.path = o.path");
+
+		db.execute(L"DROP TABLE path_map");
+
+		// The index goes along with the old table
+		db.execute(L"DROP TABLE directories_v1");
+		db.execute(L"CREATE INDEX IF NOT EXISTS ix_directories_snapshot ON " SQL_TABLE_DIRECTORIES L" (snapshot_id)");
+
+		transaction.commit();
+		pathCount = paths.size();
+	}
+	catch (...)
+	{
+		transaction.rollback();
+		throw;
+	}
+
+	cacheDbPathIds(resolved);
+
+	if (onProgress)
+		onProgress(100);
+
+	const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startTime).count();
+
+	qCDebug(lcDiagnostics) << "Directories migrated to path IDs:" << pathCount << "paths in" << elapsedMs << "ms";
+}
+
+long long
+DirectoryStore::getDbPathId(SqliteDb& db, TPathId pathId, bool addMissing, TDbPathIds& resolved) const
+{
+	auto pPathTable = PathTable::instance();
+
+	// Components not known yet, the deepest first
+	std::vector<TPathId> unknownIds;
+	long long dbPathId = 0;
+
+	{
+		std::scoped_lock lock_(m_syncDbIds);
+
+		for (TPathId id = pathId; InvalidPathId != id; id = pPathTable->parent(id))
+		{
+			auto iter = m_dbPathIds.find(id);
+			if (m_dbPathIds.end() == iter)
+			{
+				iter = resolved.find(id);
+				if (resolved.end() == iter)
+				{
+					unknownIds.push_back(id);
+					continue;
+				}
+			}
+
+			dbPathId = iter->second;
+			break;
+		}
+	}
+
+	for (auto iter = unknownIds.crbegin(); iter != unknownIds.crend(); ++iter)
+	{
+		const long long parentDbPathId = dbPathId;
+		const auto& name = pPathTable->name(*iter).toStdWString();
+
+		auto rs = db
+			.prepare(L"SELECT id FROM " SQL_TABLE_PATHS L" WHERE parent_id = ? AND name = ?")
+			.addParameter(parentDbPathId)
+			.addParameter(name)
+			.select();
+
+		if (!!rs)
+		{
+			dbPathId = rs.getInt64(0).value();
+		}
+		else
+		{
+			if (!addMissing)
+				return 0;
+
+			db.prepare(L"INSERT INTO " SQL_TABLE_PATHS L" (parent_id, name) VALUES (?, ?)")
+				.addParameter(parentDbPathId)
+				.addParameter(name)
+				.execute();
+
+			auto rsId = db.select(L"SELECT last_insert_rowid()");
+			dbPathId = rsId.getInt64(0).value();
+		}
+
+		resolved.emplace(*iter, dbPathId);
+	}
+
+	return dbPathId;
+}
+
+void
+DirectoryStore::cacheDbPathIds(const TDbPathIds& dbPathIds) const
+{
+	std::scoped_lock lock_(m_syncDbIds);
+	m_dbPathIds.insert(dbPathIds.begin(), dbPathIds.end());
+}
+
+long long
+DirectoryStore::getDbExtensionId(SqliteDb& db, TExtensionId extensionId, TDbExtensionIds& resolved) const
+{
+	{
+		std::scoped_lock lock_(m_syncDbIds);
+
+		const auto iter = m_dbExtensionIds.find(extensionId);
+		if (m_dbExtensionIds.end() != iter)
+			return iter->second;
+	}
+
+	const auto iter = resolved.find(extensionId);
+	if (resolved.end() != iter)
+		return iter->second;
+
+	const auto& name = ExtensionTable::instance()->name(extensionId).toStdWString();
+
+	long long dbExtensionId = 0;
+
+	auto rs = db
+		.prepare(L"SELECT id FROM " SQL_TABLE_EXTENSIONS L" WHERE name = ?")
+		.addParameter(name)
+		.select();
+
+	if (!!rs)
+	{
+		dbExtensionId = rs.getInt64(0).value();
+	}
+	else
+	{
+		db.prepare(L"INSERT INTO " SQL_TABLE_EXTENSIONS L" (name) VALUES (?)")
+			.addParameter(name)
+			.execute();
+
+		auto rsId = db.select(L"SELECT last_insert_rowid()");
+		dbExtensionId = rsId.getInt64(0).value();
+	}
+
+	resolved.emplace(extensionId, dbExtensionId);
+	return dbExtensionId;
+}
+
+void
+DirectoryStore::cacheDbExtensionIds(const TDbExtensionIds& dbExtensionIds) const
+{
+	std::scoped_lock lock_(m_syncDbIds);
+	m_dbExtensionIds.insert(dbExtensionIds.begin(), dbExtensionIds.end());
+}
+
+bool
+DirectoryStore::hasData() const
+{
+	for (const auto& shard_ : m_shards)
+	{
+		std::scoped_lock lock_(shard_.sync);
+		if (0 != shard_.directoryCount)
+			return true;
+	}
+
+	return false;
+}
+
+DirectoryStore::TDirectoriesSnapshot
+DirectoryStore::getSnapshot(bool withMimeDetails) const
+{
+	TDirectoriesSnapshot snapshot;
+
+	{
+		// Approximate, directories may be added in between
+		size_t count = 0;
+		for (const auto& shard_ : m_shards)
+		{
+			std::scoped_lock lock_(shard_.sync);
+			count += shard_.directoryCount;
+		}
+
+		snapshot.reserve(count);
+
+		// One shard is locked at a time, so scanning is not stopped for the whole copy
+		for (size_t shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex)
+		{
+			const auto& shard_ = m_shards[shardIndex];
+			std::scoped_lock lock_(shard_.sync);
+
+			const auto& directories = shard_.directories;
+			for (size_t slot = 0; slot < directories.size(); ++slot)
+			{
+				if (!directories[slot].isPresent())
+					continue;
+
+				const auto pathId = static_cast<TPathId>(slot * STORE_SHARD_COUNT + shardIndex);
+				snapshot.emplace_back(pathId, directories[slot].unpack(withMimeDetails));
+
+				// Read under the lock, so that the slot in the spill file is not reused in between
+				if (withMimeDetails && 0 != (directories[slot].flags & PackedDirectory::Spilled))
+					snapshot.back().second.mimeDetailsList = readSpilledMimeDetails(shard_.spillOffsets.at(pathId));
+			}
+		}
+	}
+
+	return snapshot;
+}
+
+DirectoryStore::MemoryReport
+DirectoryStore::getMemoryReport() const
+{
+	MemoryReport report;
+
+	// Lists are shared between directories and readers, each one is counted once
+	std::unordered_set<const TMimeDetailsList*> mimeLists;
+
+	for (const auto& shard_ : m_shards)
+	{
+		std::scoped_lock lock_(shard_.sync);
+
+		report.directoryCount += shard_.directoryCount;
+		report.directoryBytes += shard_.directories.capacity() * sizeof(PackedDirectory);
+
+		for (const auto& packedDir : shard_.directories)
+		{
+			if (nullptr != packedDir.mimeDetailsList &&
+				mimeLists.insert(packedDir.mimeDetailsList.get()).second)
+			{
+				report.mimeListBytes += packedDir.mimeDetailsList->memoryUsage();
+			}
+		}
+
+		report.spilledMimeListCount += shard_.spillOffsets.size() + shard_.listingSpillOffsets.size();
+
+		report.listingCount += shard_.listings.size();
+		report.listingBytes += shard_.listings.bucket_count() * sizeof(void*);
+		for (const auto& pairListing : shard_.listings)
+		{
+			const auto& listing = pairListing.second;
+
+			// Node: next pointer and the value
+			report.listingBytes += sizeof(void*) + sizeof(pairListing) +
+				listing.ownMimeSizes.memoryUsage() - sizeof(listing.ownMimeSizes) +
+				listing.subdirectories.capacity() * sizeof(TPathId);
+		}
+	}
+
+	report.mimeListCount = mimeLists.size();
+
+	// Node (next pointer and the value) and a bucket per directory
+	report.unpackedDirectoryBytes = report.directoryCount *
+		(sizeof(void*) + sizeof(std::pair<const TPathId, DirectoryDetails>) + sizeof(void*));
+
+	report.pathBytes = PathTable::instance()->memoryUsage();
+
+	{
+		std::scoped_lock lock_(m_syncSpill);
+		report.spillFileBytes = nullptr != m_pSpillFile ? m_pSpillFile->size() : 0;
+		report.spillFileFreeBytes = nullptr != m_pSpillFile ? m_pSpillFile->freeSize() : 0;
+	}
+
+	return report;
+}
+
+void
+DirectoryStore::collectUnsavedChanges(
+	std::vector<SavedDirectory>& changed,
+	std::vector<TPathId>& removed)
+{
+	// One shard is locked at a time. A directory changed in a shard already collected
+	//	is not Persisted after the save, so it goes to the next snapshot.
+	for (size_t shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex)
+	{
+		auto& shard_ = m_shards[shardIndex];
+		std::scoped_lock lock_(shard_.sync);
+
+		const auto& directories = shard_.directories;
+		for (size_t slot = 0; slot < directories.size(); ++slot)
+		{
+			const auto& packedDir = directories[slot];
+			if (!packedDir.isPresent() ||
+				0 != (packedDir.flags & PackedDirectory::Persisted))
+			{
+				continue;
+			}
+
+			// Directories with complete results only
+			const auto& stats = packedDir.stats();
+			if ((DirectoryProcessingStatus::Ready != packedDir.getStatus() &&
+				 DirectoryProcessingStatus::Stale != packedDir.getStatus()) ||
+				!stats.totalFileCount.has_value() ||
+				!stats.totalSize.has_value() ||
+				!stats.subdirectoryCount.has_value())
+			{
+				continue;
+			}
+
+			const auto pathId = static_cast<TPathId>(slot * STORE_SHARD_COUNT + shardIndex);
+
+			SavedDirectory savedDir{ pathId, stats };
+
+			// Spilled ones are read under the lock, so that their slots are not reused in between
+			if (stats.totalSize.value() >= m_mimeDetailsMinSize)
+			{
+				if (0 != (packedDir.flags & PackedDirectory::Spilled))
+					savedDir.mimeDetailsList = readSpilledMimeDetails(shard_.spillOffsets.at(pathId));
+				else
+					savedDir.mimeDetailsList = packedDir.mimeDetailsList;
+			}
+
+			changed.push_back(std::move(savedDir));
+		}
+
+		// Could be created again in between
+		for (auto pathId : shard_.removedPersisted)
+		{
+			if (nullptr == shard_.find(pathId))
+				removed.push_back(pathId);
+		}
+
+		shard_.removedPersisted.clear();
+	}
+}
+
+void
+DirectoryStore::markPersisted(const std::vector<SavedDirectory>& saved)
+{
+	for (const auto& savedDir : saved)
+	{
+		auto& shard_ = shard(savedDir.pathId);
+		std::scoped_lock lock_(shard_.sync);
+
+		auto pPackedDir = shard_.find(savedDir.pathId);
+		if (nullptr != pPackedDir && pPackedDir->hasSameStats(savedDir.stats) &&
+			(nullptr == savedDir.mimeDetailsList ||
+			 hasSameMimeDetails(shard_, savedDir.pathId, *pPackedDir, savedDir.mimeDetailsList)))
+		{
+			pPackedDir->flags |= PackedDirectory::Persisted;
+		}
+	}
+}
+
+void
+DirectoryStore::saveCurrentData()
+{
+	upgradeDatabase();
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	std::scoped_lock lock_(m_syncDb);
+
+	std::vector<SavedDirectory> changed;
+	std::vector<TPathId> removed;
+	collectUnsavedChanges(changed, removed);
+
+	// Tombstones are taken from the shards, so they are put back if not saved
+	auto restoreRemoved = scope_guard([&](auto) {
+		for (auto pathId : removed)
+		{
+			auto& shard_ = shard(pathId);
+			std::scoped_lock lockShard_(shard_.sync);
+			shard_.removedPersisted.push_back(pathId);
+		}
+	});
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	// Durable at checkpoints, which is enough for snapshots (WAL is set in checkCreateDbSchema)
+	db.execute(L"PRAGMA synchronous=NORMAL");
+	db.execute(L"PRAGMA temp_store=MEMORY");
+	db.execute(L"PRAGMA cache_size=-65536");
+
+	struct Row
+	{
+		long long dbPathId;
+		long long totalFileCount;
+		long long totalSize;
+		long long subdirectoryCount;
+		int removed;
+	};
+
+	std::vector<Row> rows;
+	rows.reserve(changed.size() + removed.size());
+
+	struct MimeRow
+	{
+		long long dbPathId;
+		long long dbExtensionId;
+		long long fileCount;
+		long long totalSize;
+	};
+
+	std::vector<MimeRow> mimeRows;
+
+	// Paths and extensions first saved by this snapshot are known once it is committed
+	TDbPathIds resolved;
+	TDbExtensionIds resolvedExtensions;
+
+	auto transaction = db.beginTransaction();
+
+	try
+	{
+		for (const auto& changedDir : changed)
+		{
+			const long long dbPathId = getDbPathId(db, changedDir.pathId, true, resolved);
+
+			rows.push_back(Row{
+				dbPathId,
+				static_cast<long long>(changedDir.stats.totalFileCount.value()),
+				static_cast<long long>(changedDir.stats.totalSize.value()),
+				static_cast<long long>(changedDir.stats.subdirectoryCount.value()),
+				0 });
+
+			const auto& pMimeDetails = changedDir.mimeDetailsList;
+			if (nullptr == pMimeDetails)
+				continue;
+
+			for (const auto& item : *pMimeDetails)
+			{
+				if (0 == item.second.fileCount)
+					continue;
+
+				mimeRows.push_back(MimeRow{
+					dbPathId,
+					getDbExtensionId(db, item.first, resolvedExtensions),
+					static_cast<long long>(item.second.fileCount),
+					static_cast<long long>(item.second.totalSize) });
+			}
+		}
+
+		for (auto pathId : removed)
+			rows.push_back(Row{ getDbPathId(db, pathId, true, resolved), 0, 0, 0, 1 });
+
+		// Appended in primary key order
+		std::sort(rows.begin(), rows.end(), [](const Row& lhs, const Row& rhs) {
+			return lhs.dbPathId < rhs.dbPathId;
+		});
+
+		std::sort(mimeRows.begin(), mimeRows.end(), [](const MimeRow& lhs, const MimeRow& rhs) {
+			return lhs.dbPathId < rhs.dbPathId ||
+				(lhs.dbPathId == rhs.dbPathId && lhs.dbExtensionId < rhs.dbExtensionId);
+		});
+
+		// Create new snapshot, even an empty delta is a point of history
+		db.prepare(L"INSERT INTO " SQL_TABLE_SNAPSHOTS L" (date_time) VALUES (?); ")
+			.addParameter(std::chrono::utc_clock::now())
+			.execute();
+
+		// Get snapshot id
+		auto rs = db.select(L"SELECT MAX(last_insert_rowid()) FROM " SQL_TABLE_SNAPSHOTS);
+		const int snapshotId = rs.getInt(0).value();
+
+		insertBatched(
+			db,
+			L"INSERT INTO " SQL_TABLE_DIRECTORIES L" (snapshot_id, path_id, total_file_count, total_size, subdir_count, removed)",
+			L"(?, ?, ?, ?, ?, ?)",
+			rows.size(),
+			[&](auto& cmd, size_t i) {
+				const auto& row = rows[i];
+				cmd.addParameter(snapshotId)
+					.addParameter(row.dbPathId)
+					.addParameter(row.totalFileCount)
+					.addParameter(row.totalSize)
+					.addParameter(row.subdirectoryCount)
+					.addParameter(row.removed);
+			});
+
+		insertBatched(
+			db,
+			L"INSERT INTO " SQL_TABLE_MIME_DETAILS L" (snapshot_id, path_id, extension_id, file_count, total_size)",
+			L"(?, ?, ?, ?, ?)",
+			mimeRows.size(),
+			[&](auto& cmd, size_t i) {
+				const auto& mimeRow = mimeRows[i];
+				cmd.addParameter(snapshotId)
+					.addParameter(mimeRow.dbPathId)
+					.addParameter(mimeRow.dbExtensionId)
+					.addParameter(mimeRow.fileCount)
+					.addParameter(mimeRow.totalSize);
+			});
+
+		transaction.commit();
+	}
+	catch (...)
+	{
+		transaction.rollback();
+		throw;
+	}
+
+	removed.clear();
+	cacheDbPathIds(resolved);
+	cacheDbExtensionIds(resolvedExtensions);
+	markPersisted(changed);
+
+	const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startTime).count();
+
+	qCDebug(lcDiagnostics) << "Snapshot saved:" << rows.size() << "changed directories," << mimeRows.size() << "mime details in"
+		<< elapsedMs << "ms," << ((rows.size() + mimeRows.size()) * 1000 / std::max<long long>(elapsedMs, 1)) << "rows/s";
+}
+
+size_t
+DirectoryStore::loadLastSnapshot(const TLoadedCallback& onLoaded, const TCancelledPredicate& isCancelled)
+{
+	upgradeDatabase();
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	struct DbPath
+	{
+		long long parentId;
+		QString name;
+		TPathId pathId = InvalidPathId;		// Once interned
+	};
+
+	// Saved paths are interned only if a loaded directory is (or is under) them
+	std::unordered_map<long long, DbPath> dbPaths;
+	{
+		auto rsPaths = db.select(L"SELECT id, parent_id, name FROM " SQL_TABLE_PATHS);
+		for (; !!rsPaths && !isCancelled(); ++rsPaths)
+		{
+			dbPaths.emplace(rsPaths.getInt64(0).value(), DbPath{
+				rsPaths.getInt64(1).value(),
+				QString::fromStdWString(rsPaths.getString(2).value()) });
+		}
+	}
+
+	auto pPathTable = PathTable::instance();
+	TDbPathIds resolved;
+
+	const auto internDbPath = [&](long long dbPathId) {
+		// Components not interned yet, the deepest first
+		std::vector<std::pair<long long, DbPath*>> chain;
+		TPathId parentId = InvalidPathId;
+
+		for (long long id = dbPathId; 0 != id;)
+		{
+			auto iter = dbPaths.find(id);
+			if (dbPaths.end() == iter)
+				return InvalidPathId;
+
+			if (InvalidPathId != iter->second.pathId)
+			{
+				parentId = iter->second.pathId;
+				break;
+			}
+
+			chain.emplace_back(id, &iter->second);
+			id = iter->second.parentId;
+		}
+
+		for (auto iter = chain.crbegin(); iter != chain.crend(); ++iter)
+		{
+			parentId = pPathTable->internChild(parentId, iter->second->name);
+			iter->second->pathId = parentId;
+			resolved.emplace(parentId, iter->first);
+		}
+
+		return parentId;
+	};
+
+	// The latest row of each directory, unless it is a tombstone
+	const auto sqlQuery =
+		L"SELECT d.path_id, d.total_file_count, d.total_size, d.subdir_count \nFROM "
+		SQL_TABLE_DIRECTORIES L" d\n"
+		L"JOIN (SELECT path_id, MAX(snapshot_id) AS snapshot_id FROM " SQL_TABLE_DIRECTORIES L" GROUP BY path_id) l\n"
+		L"ON d.path_id = l.path_id AND d.snapshot_id = l.snapshot_id\n"
+		L"WHERE d.removed = 0";
+
+	auto rs = db.select(sqlQuery);
+
+	size_t loadedCount = 0;
+	std::vector<TPathId> loaded;
+	loaded.reserve(LOAD_SNAPSHOT_BATCH_SIZE);
+
+	for (; !!rs && !isCancelled(); ++rs)
+	{
+		const TPathId pathId = internDbPath(rs.getInt64(0).value());
+		if (InvalidPathId == pathId)
+			continue;
+
+		DirectoryStats stats;
+		stats.totalFileCount = rs.getInt64(1);
+		stats.totalSize = rs.getInt64(2);
+		stats.subdirectoryCount = rs.getInt64(3);
+
+		{
+			auto& shard_ = shard(pathId);
+			std::scoped_lock lock_(shard_.sync);
+
+			// Scanned (or being scanned) since the start
+			if (nullptr != shard_.find(pathId))
+				continue;
+
+			auto& packedDir = shard_.findOrAdd(pathId);
+			packedDir.setStatus(DirectoryProcessingStatus::Stale);
+			packedDir.assignStats(stats);
+
+			// Saved again only if changed
+			packedDir.flags |= PackedDirectory::Persisted;
+		}
+
+		loaded.push_back(pathId);
+		if (loaded.size() >= LOAD_SNAPSHOT_BATCH_SIZE)
+		{
+			loadedCount += loaded.size();
+			onLoaded(loaded);
+			loaded.clear();
+		}
+	}
+
+	if (!loaded.empty())
+	{
+		loadedCount += loaded.size();
+		onLoaded(loaded);
+	}
+
+	// Later saves resolve paths without querying the database
+	cacheDbPathIds(resolved);
+
+	if (isCancelled())
+		return loadedCount;
+
+	std::unordered_map<long long, TExtensionId> extensionIds;
+	{
+		auto pExtensionTable = ExtensionTable::instance();
+
+		auto rsExtensions = db.select(L"SELECT id, name FROM " SQL_TABLE_EXTENSIONS);
+		for (; !!rsExtensions; ++rsExtensions)
+		{
+			extensionIds.emplace(rsExtensions.getInt64(0).value(),
+				pExtensionTable->intern(QString::fromStdWString(rsExtensions.getString(1).value())));
+		}
+	}
+
+	// Only directories still as loaded get mime details
+	const auto assignLoadedMimeDetails = [&](long long dbPathId, TMimeDetailsListPtr pMimeDetails) {
+		const auto iter = dbPaths.find(dbPathId);
+		if (dbPaths.end() == iter || InvalidPathId == iter->second.pathId)
+			return;
+
+		const TPathId pathId = iter->second.pathId;
+
+		auto& shard_ = shard(pathId);
+		std::scoped_lock lock_(shard_.sync);
+
+		auto pPackedDir = shard_.find(pathId);
+		if (nullptr == pPackedDir ||
+			DirectoryProcessingStatus::Stale != pPackedDir->getStatus() ||
+			0 == (pPackedDir->flags & PackedDirectory::Persisted) ||
+			0 != (pPackedDir->flags & PackedDirectory::Spilled) ||
+			nullptr != pPackedDir->mimeDetailsList)
+		{
+			return;
+		}
+
+		// Same as saved
+		assignMimeDetails(shard_, pathId, *pPackedDir, std::move(pMimeDetails), true);
+	};
+
+	// Mime details of the latest rows, grouped by directory
+	const auto sqlMimeQuery =
+		L"SELECT m.path_id, m.extension_id, m.file_count, m.total_size \nFROM "
+		SQL_TABLE_MIME_DETAILS L" m\n"
+		L"JOIN (SELECT path_id, MAX(snapshot_id) AS snapshot_id FROM " SQL_TABLE_DIRECTORIES L" GROUP BY path_id) l\n"
+		L"ON m.path_id = l.path_id AND m.snapshot_id = l.snapshot_id\n"
+		L"ORDER BY m.path_id, m.extension_id";
+
+	auto rsMime = db.select(sqlMimeQuery);
+
+	std::shared_ptr<TMimeDetailsList> pMimeDetails;
+	long long mimeDbPathId = 0;
+	size_t mimeListCount = 0;
+
+	for (; !!rsMime && !isCancelled(); ++rsMime)
+	{
+		const long long dbPathId = rsMime.getInt64(0).value();
+		if (dbPathId != mimeDbPathId)
+		{
+			if (nullptr != pMimeDetails)
+			{
+				assignLoadedMimeDetails(mimeDbPathId, std::move(pMimeDetails));
+				if (0 == ++mimeListCount % LOAD_SNAPSHOT_BATCH_SIZE)
+					enforceMemoryBudget();
+			}
+
+			mimeDbPathId = dbPathId;
+			pMimeDetails = std::make_shared<TMimeDetailsList>();
+		}
+
+		const auto iterExtension = extensionIds.find(rsMime.getInt64(1).value());
+		if (extensionIds.end() == iterExtension)
+			continue;
+
+		pMimeDetails->addMimeDetails(
+			iterExtension->second,
+			static_cast<unsigned long long>(rsMime.getInt64(3).value()),
+			static_cast<unsigned long>(rsMime.getInt64(2).value()));
+	}
+
+	if (nullptr != pMimeDetails && !isCancelled())
+		assignLoadedMimeDetails(mimeDbPathId, std::move(pMimeDetails));
+
+	enforceMemoryBudget();
+
+	return loadedCount;
+}
+
+DirectoryStore::TDirectoryStatsHistory
+DirectoryStore::getDirectoryStatsHistory(const QString& unifiedPath) const
+{
+	upgradeDatabase();
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	TDirectoryStatsHistory history;
+
+	const TPathId pathId = PathTable::instance()->find(unifiedPath);
+	if (InvalidPathId == pathId)
+		return history;
+
+	// Read only, so the found IDs are committed ones
+	TDbPathIds resolved;
+	const long long dbPathId = getDbPathId(db, pathId, false, resolved);
+	cacheDbPathIds(resolved);
+
+	if (0 == dbPathId)
+		return history;
+
+	// Each snapshot gets the latest row of the directory saved up to it (a primary key seek)
+	const auto sqlQuery =
+		L"SELECT s.date_time, d.total_file_count, d.total_size, d.subdir_count \nFROM "
+		SQL_TABLE_SNAPSHOTS L" s\n"
+		L"JOIN " SQL_TABLE_DIRECTORIES L" d\n"
+		L"ON d.path_id = ? AND d.snapshot_id = (SELECT MAX(d2.snapshot_id) FROM " SQL_TABLE_DIRECTORIES L" d2\n"
+		L"  WHERE d2.path_id = ? AND d2.snapshot_id <= s.id)\n"
+		L"WHERE d.removed = 0\n"
+		L"ORDER BY s.date_time";
+
+	auto rs = db.prepare(sqlQuery)
+				.addParameter(dbPathId)
+				.addParameter(dbPathId)
+				.select();
+
+	for (; !!rs; ++rs)
+	{
+		auto dt = rs.getDateTime(0);
+		assert(dt.has_value());
+
+		DirectoryStats dirStats;
+		dirStats.totalFileCount = rs.getInt64(1);
+		dirStats.totalSize = rs.getInt64(2);
+		dirStats.subdirectoryCount = rs.getInt64(3);
+
+		history.emplace(std::make_pair(dt.value(), dirStats));
+	}
+
+	return history;
+}
+
+DirectoryStore::TMimeDetailsHistory
+DirectoryStore::getDirectoryMimeDetailsHistory(const QString& unifiedPath) const
+{
+	upgradeDatabase();
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	TMimeDetailsHistory history;
+
+	const TPathId pathId = PathTable::instance()->find(unifiedPath);
+	if (InvalidPathId == pathId)
+		return history;
+
+	// Read only, so the found IDs are committed ones
+	TDbPathIds resolved;
+	const long long dbPathId = getDbPathId(db, pathId, false, resolved);
+	cacheDbPathIds(resolved);
+
+	if (0 == dbPathId)
+		return history;
+
+	// Each row of the directory covers snapshots until its next row, so mime details
+	//	are read once per row rather than looked up for each snapshot (tombstones have none)
+	const auto sqlQuery =
+		L"SELECT s.date_time, e.name, m.file_count, m.total_size \nFROM "
+		L"(SELECT snapshot_id, LEAD(snapshot_id) OVER (ORDER BY snapshot_id) AS next_snapshot_id\n"
+		L"  FROM " SQL_TABLE_DIRECTORIES L" WHERE path_id = ?) d\n"
+		L"JOIN " SQL_TABLE_MIME_DETAILS L" m\n"
+		L"ON m.path_id = ? AND m.snapshot_id = d.snapshot_id\n"
+		L"JOIN " SQL_TABLE_EXTENSIONS L" e\n"
+		L"ON e.id = m.extension_id\n"
+		L"JOIN " SQL_TABLE_SNAPSHOTS L" s\n"
+		L"ON s.id >= d.snapshot_id AND (d.next_snapshot_id IS NULL OR s.id < d.next_snapshot_id)\n"
+		L"ORDER BY s.date_time";
+
+	auto rs = db.prepare(sqlQuery)
+				.addParameter(dbPathId)
+				.addParameter(dbPathId)
+				.select();
+
+	for (; !!rs; ++rs)
+	{
+		auto dt = rs.getDateTime(0);
+		assert(dt.has_value());
+
+		history[dt.value()].addMimeDetails(
+			QString::fromStdWString(rs.getString(1).value()),
+			static_cast<unsigned long long>(rs.getInt64(3).value()),
+			static_cast<unsigned long>(rs.getInt64(2).value()));
+	}
+
+	return history;
+}
+
+DirectoryStore::TMimeTypesHistory
+DirectoryStore::getMimeTypesHistory(const QString& unifiedPath, const std::vector<QString>& mimeTypes) const
+{
+	upgradeDatabase();
+
+	TMimeTypesHistory history;
+
+	if (mimeTypes.empty())
+		return history;
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	const TPathId pathId = PathTable::instance()->find(unifiedPath);
+	if (InvalidPathId == pathId)
+		return history;
+
+	// Read only, so the found IDs are committed ones
+	TDbPathIds resolved;
+	const long long dbPathId = getDbPathId(db, pathId, false, resolved);
+	cacheDbPathIds(resolved);
+
+	if (0 == dbPathId)
+		return history;
+
+	// ALL_MIMETYPE is read as well, it marks snapshots where mime details are saved
+	std::unordered_map<long long, QString> dbExtensionMimeTypes;
+	std::optional<long long> dbAllExtensionId;
+
+	std::vector<QString> queriedMimeTypes(mimeTypes);
+	queriedMimeTypes.push_back(TMimeDetailsList::ALL_MIMETYPE);
+
+	for (const auto& mimeType : queriedMimeTypes)
+	{
+		auto rsExtension = db
+			.prepare(L"SELECT id FROM " SQL_TABLE_EXTENSIONS L" WHERE name = ?")
+			.addParameter(mimeType.toStdWString())
+			.select();
+
+		if (!rsExtension)
+			continue;
+
+		const long long dbExtensionId = rsExtension.getInt64(0).value();
+		dbExtensionMimeTypes.emplace(dbExtensionId, mimeType);
+
+		if (TMimeDetailsList::ALL_MIMETYPE == mimeType)
+			dbAllExtensionId = dbExtensionId;
+	}
+
+	if (!dbAllExtensionId.has_value())
+		return history;
+
+	std::wstring sqlExtensionIds;
+	for (size_t i = 0; i < dbExtensionMimeTypes.size(); ++i)
+		sqlExtensionIds += 0 == i ? L"?" : L", ?";
+
+	// Each row of the directory covers snapshots until its next row, a primary key seek
+	//	per row and mime type (tombstones have no mime details)
+	const auto& sqlQuery =
+		L"SELECT s.date_time, m.extension_id, m.file_count, m.total_size \nFROM "
+		L"(SELECT snapshot_id, LEAD(snapshot_id) OVER (ORDER BY snapshot_id) AS next_snapshot_id\n"
+		L"  FROM " SQL_TABLE_DIRECTORIES L" WHERE path_id = ?) d\n"
+		L"JOIN " SQL_TABLE_MIME_DETAILS L" m\n"
+		L"ON m.path_id = ? AND m.snapshot_id = d.snapshot_id AND m.extension_id IN (" + sqlExtensionIds + L")\n"
+		L"JOIN " SQL_TABLE_SNAPSHOTS L" s\n"
+		L"ON s.id >= d.snapshot_id AND (d.next_snapshot_id IS NULL OR s.id < d.next_snapshot_id)\n"
+		L"ORDER BY s.date_time";
+
+	auto cmd = db.prepare(sqlQuery);
+	cmd.addParameter(dbPathId)
+		.addParameter(dbPathId);
+
+	for (const auto& dbExtension : dbExtensionMimeTypes)
+		cmd.addParameter(dbExtension.first);
+
+	auto rs = cmd.select();
+
+	for (; !!rs; ++rs)
+	{
+		auto dt = rs.getDateTime(0);
+		assert(dt.has_value());
+
+		const long long dbExtensionId = rs.getInt64(1).value();
+		if (dbAllExtensionId.value() == dbExtensionId)
+		{
+			// Mime types without files in this snapshot
+			for (const auto& mimeType : mimeTypes)
+				history[mimeType].emplace(dt.value(), MimeDetails{});
+
+			continue;
+		}
+
+		MimeDetails mimeDetails;
+		mimeDetails.fileCount = static_cast<unsigned long>(rs.getInt64(2).value());
+		mimeDetails.totalSize = static_cast<unsigned long long>(rs.getInt64(3).value());
+
+		history[dbExtensionMimeTypes.at(dbExtensionId)][dt.value()] = mimeDetails;
+	}
+
+	return history;
+}
+
+DirectoryStore::TSnapshotList
+DirectoryStore::getSnapshots() const
+{
+	upgradeDatabase();
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	TSnapshotList snapshots;
+
+	auto rs = db.select(L"SELECT id, date_time FROM " SQL_TABLE_SNAPSHOTS L" ORDER BY id");
+	for (; !!rs; ++rs)
+	{
+		auto dt = rs.getDateTime(1);
+		assert(dt.has_value());
+
+		snapshots.emplace_back(rs.getInt64(0).value(), dt.value());
+	}
+
+	return snapshots;
+}
+
+DirectoryStore::SnapshotDiff
+DirectoryStore::diffSnapshots(long long fromSnapshotId, long long toSnapshotId, size_t topCount) const
+{
+	upgradeDatabase();
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	const auto& dbFileName = getDbFileName();
+	SqliteDb db(dbFileName);
+
+	SnapshotDiff diff;
+
+	const long long loSnapshotId = std::min(fromSnapshotId, toSnapshotId);
+	const long long hiSnapshotId = std::max(fromSnapshotId, toSnapshotId);
+
+	if (loSnapshotId == hiSnapshotId || 0 == topCount)
+		return diff;
+
+	// Path IDs are allocated sequentially
+	auto rsPathCount = db.select(L"SELECT MAX(id) FROM " SQL_TABLE_PATHS);
+	const long long pathCount = rsPathCount.getInt64(0).value_or(0);
+	if (0 == pathCount)
+		return diff;
+
+	// Rows saved after the older snapshot up to the newer one (an index range), counted up to the limit
+	const long long seekLimit = std::max(pathCount / DIFF_SEEK_PATH_RATIO, 1LL);
+	auto rsDeltaCount = db
+		.prepare(L"SELECT COUNT(*) FROM (SELECT 1 FROM " SQL_TABLE_DIRECTORIES L" WHERE snapshot_id > ? AND snapshot_id <= ? LIMIT ?)")
+		.addParameter(loSnapshotId)
+		.addParameter(hiSnapshotId)
+		.addParameter(seekLimit)
+		.select();
+
+	const bool seek = rsDeltaCount.getInt64(0).value() < seekLimit;
+
+	// Both queries return rows of a directory together, the newest first, and directories
+	//	by descending path ID, so subdirectories come before their parents.
+	// Seek: the latest row up to each snapshot of the directories with delta rows in between.
+	// Scan: all rows up to the newer snapshot in primary key order (no sorting), parent IDs are
+	//	merged in from the paths table read in the same order.
+	const auto sqlQuery = seek
+		? L"SELECT d.path_id, p.parent_id, d.snapshot_id, d.total_file_count, d.total_size, d.subdir_count, d.removed \nFROM "
+			L"(SELECT DISTINCT path_id FROM " SQL_TABLE_DIRECTORIES L" WHERE snapshot_id > ? AND snapshot_id <= ?) c\n"
+			L"JOIN " SQL_TABLE_DIRECTORIES L" d\n"
+			L"ON d.path_id = c.path_id AND d.snapshot_id IN (\n"
+			L"  (SELECT MAX(snapshot_id) FROM " SQL_TABLE_DIRECTORIES L" WHERE path_id = c.path_id AND snapshot_id <= ?),\n"
+			L"  (SELECT MAX(snapshot_id) FROM " SQL_TABLE_DIRECTORIES L" WHERE path_id = c.path_id AND snapshot_id <= ?))\n"
+			L"JOIN " SQL_TABLE_PATHS L" p\n"
+			L"ON p.id = d.path_id\n"
+			L"ORDER BY d.path_id DESC, d.snapshot_id DESC"
+		: L"SELECT path_id, 0, snapshot_id, total_file_count, total_size, subdir_count, removed \nFROM "
+			SQL_TABLE_DIRECTORIES L"\n"
+			L"WHERE snapshot_id <= ?\n"
+			L"ORDER BY path_id DESC, snapshot_id DESC";
+
+	auto cmd = db.prepare(sqlQuery);
+	if (seek)
+	{
+		cmd.addParameter(loSnapshotId)
+			.addParameter(hiSnapshotId)
+			.addParameter(loSnapshotId)
+			.addParameter(hiSnapshotId);
+	}
+	else
+	{
+		cmd.addParameter(hiSnapshotId);
+	}
+
+	auto rs = cmd.select();
+
+	std::optional<decltype(rs)> rsParents;
+	if (!seek)
+		rsParents.emplace(db.select(L"SELECT id, parent_id FROM " SQL_TABLE_PATHS L" ORDER BY id DESC"));
+
+	struct Candidate
+	{
+		long long dbPathId;
+		unsigned long long sizeFrom;
+		unsigned long long sizeTo;
+		StatsDelta subtreeDelta;
+		StatsDelta ownDelta;
+	};
+
+	// The smallest growth and the smallest loss are on top to be dropped first
+	const auto growsLess = [](const Candidate& lhs, const Candidate& rhs) {
+		return lhs.ownDelta.totalSize > rhs.ownDelta.totalSize;
+	};
+	const auto shrinksLess = [](const Candidate& lhs, const Candidate& rhs) {
+		return lhs.ownDelta.totalSize < rhs.ownDelta.totalSize;
+	};
+
+	std::priority_queue<Candidate, std::vector<Candidate>, decltype(growsLess)> growers(growsLess);
+	std::priority_queue<Candidate, std::vector<Candidate>, decltype(shrinksLess)> shrinkers(shrinksLess);
+
+	// Sum of subtree deltas of changed subdirectories, by parent path ID. Parents come later
+	//	than their subdirectories, an entry is taken once its directory comes. Entries of parents
+	//	without rows (seek) are dropped once passed, whenever the map doubles.
+	std::unordered_map<long long, StatsDelta> childDeltas;
+	size_t childDeltasPruneSize = DIFF_CHILD_DELTAS_MIN_PRUNE_SIZE;
+
+	// Stats of the current directory as of each snapshot (absent if removed or not saved yet)
+	struct Group
+	{
+		long long dbPathId = 0;
+		long long dbParentId = 0;
+		long long lastSnapshotId = 0;
+		std::optional<StatsDelta> loStats;
+		std::optional<StatsDelta> hiStats;
+		bool loFound = false;
+	} group;
+
+	const auto finishGroup = [&]() {
+		if (0 == group.dbPathId)
+			return;
+
+		StatsDelta childrenDelta;
+
+		auto iterChildren = childDeltas.find(group.dbPathId);
+		if (childDeltas.end() != iterChildren)
+		{
+			childrenDelta = iterChildren->second;
+			childDeltas.erase(iterChildren);
+		}
+
+		// Not saved since the older snapshot
+		if (group.lastSnapshotId <= loSnapshotId)
+			return;
+
+		const bool reversed = fromSnapshotId > toSnapshotId;
+		const auto& fromStats = reversed ? group.hiStats : group.loStats;
+		const auto& toStats = reversed ? group.loStats : group.hiStats;
+
+		StatsDelta subtreeDelta = toStats.value_or(StatsDelta{});
+		subtreeDelta -= fromStats.value_or(StatsDelta{});
+
+		if (subtreeDelta.isZero() && fromStats.has_value() == toStats.has_value())
+			return;
+
+		++diff.changedDirectoryCount;
+
+		StatsDelta ownDelta = subtreeDelta;
+		ownDelta -= childrenDelta;
+
+		if (0 != group.dbParentId)
+			childDeltas[group.dbParentId] += subtreeDelta;
+
+		const Candidate candidate{
+			group.dbPathId,
+			static_cast<unsigned long long>(fromStats.value_or(StatsDelta{}).totalSize),
+			static_cast<unsigned long long>(toStats.value_or(StatsDelta{}).totalSize),
+			subtreeDelta,
+			ownDelta };
+
+		if (0 < ownDelta.totalSize)
+		{
+			growers.push(candidate);
+			if (growers.size() > topCount)
+				growers.pop();
+		}
+		else if (0 > ownDelta.totalSize)
+		{
+			shrinkers.push(candidate);
+			if (shrinkers.size() > topCount)
+				shrinkers.pop();
+		}
+	};
+
+	for (; !!rs; ++rs)
+	{
+		const long long dbPathId = rs.getInt64(0).value();
+		const long long snapshotId = rs.getInt64(2).value();
+
+		if (dbPathId == group.dbPathId)
+		{
+			// Rows older than the one effective at the older snapshot are not needed
+			if (group.loFound || snapshotId > loSnapshotId)
+				continue;
+		}
+		else
+		{
+			finishGroup();
+
+			if (childDeltas.size() > childDeltasPruneSize)
+			{
+				std::erase_if(childDeltas, [dbPathId](const auto& entry) { return entry.first > dbPathId; });
+				childDeltasPruneSize = std::max<size_t>(childDeltas.size() * 2, DIFF_CHILD_DELTAS_MIN_PRUNE_SIZE);
+			}
+
+			group = Group{};
+			group.dbPathId = dbPathId;
+			group.lastSnapshotId = snapshotId;
+
+			if (seek)
+			{
+				group.dbParentId = rs.getInt64(1).value();
+			}
+			else
+			{
+				auto& rsPaths = rsParents.value();
+				for (; !!rsPaths && rsPaths.getInt64(0).value() > dbPathId; ++rsPaths)
+					;
+
+				if (!!rsPaths && rsPaths.getInt64(0).value() == dbPathId)
+					group.dbParentId = rsPaths.getInt64(1).value();
+			}
+		}
+
+		std::optional<StatsDelta> stats;
+		if (0 == rs.getInt(6).value())
+		{
+			stats = StatsDelta{
+				rs.getInt64(4).value(),
+				rs.getInt64(3).value(),
+				rs.getInt64(5).value() };
+		}
+
+		if (snapshotId <= loSnapshotId)
+		{
+			group.loStats = stats;
+			group.loFound = true;
+		}
+
+		if (snapshotId == group.lastSnapshotId)
+			group.hiStats = stats;
+	}
+
+	finishGroup();
+
+	// Unified paths of the ranked directories (and their ancestors) only
+	std::unordered_map<long long, QString> dbPathTexts;
+
+	const auto getPathText = [&](long long dbPathId) {
+		// Components without text yet, the deepest first
+		std::vector<std::pair<long long, QString>> chain;
+		QString pathText;
+
+		for (long long id = dbPathId; 0 != id;)
+		{
+			auto iter = dbPathTexts.find(id);
+			if (dbPathTexts.end() != iter)
+			{
+				pathText = iter->second;
+				break;
+			}
+
+			auto rsPath = db
+				.prepare(L"SELECT parent_id, name FROM " SQL_TABLE_PATHS L" WHERE id = ?")
+				.addParameter(id)
+				.select();
+
+			if (!rsPath)
+				break;
+
+			chain.emplace_back(id, QString::fromStdWString(rsPath.getString(1).value()));
+			id = rsPath.getInt64(0).value();
+		}
+
+		for (auto iter = chain.crbegin(); iter != chain.crend(); ++iter)
+		{
+			pathText = pathText.isEmpty() ? iter->second : getUnifiedChildPath(pathText, iter->second);
+			dbPathTexts.emplace(iter->first, pathText);
+		}
+
+		return pathText;
+	};
+
+	// Heaps give the smallest changes first
+	const auto takeRanked = [&](auto& heap, std::vector<DirectoryDiff>& ranked) {
+		ranked.resize(heap.size());
+
+		for (auto iter = ranked.rbegin(); iter != ranked.rend(); ++iter)
+		{
+			const Candidate& candidate = heap.top();
+
+			iter->unifiedPath = getPathText(candidate.dbPathId);
+			iter->sizeFrom = candidate.sizeFrom;
+			iter->sizeTo = candidate.sizeTo;
+			iter->subtreeDelta = candidate.subtreeDelta;
+			iter->ownDelta = candidate.ownDelta;
+
+			heap.pop();
+		}
+	};
+
+	takeRanked(growers, diff.growers);
+	takeRanked(shrinkers, diff.shrinkers);
+
+	const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startTime).count();
+
+	qCDebug(lcDiagnostics) << "Snapshots" << fromSnapshotId << "and" << toSnapshotId << "diffed by"
+		<< (seek ? "seeks:" : "scan:") << diff.changedDirectoryCount << "changed directories in" << elapsedMs << "ms";
+
+	return diff;
 }
@@ -1,12 +1,30 @@
 #ifndef DIRECTORYSTORE_H
 #define DIRECTORYSTORE_H
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <map>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <chrono>
+#include <functional>
+#include <optional>
 #include <QString>
 
 #include "DirectoryDetails.h"
+#include "DirectoryListing.h"
+#include "PackedDirectory.h"
+#include "MimeSpillFile.h"
+#include "PathTable.h"
+
+class SqliteDb;
+
+// Number of independently locked parts of the store, directories are distributed by path ID
+#define STORE_SHARD_COUNT 64
 
 class DirectoryStore
 {
@@ -20,20 +38,83 @@ public:
 		const QString& unifiedPath,
 		const DirectoryDetails& dirDetails,
 		bool updateDirectoryStats);
+	void upsertDirectory(
+		TPathId pathId,
+		const DirectoryDetails& dirDetails,
+		bool updateDirectoryStats);
 
 	// If fillinMimeSizesOnlyIfReady == true,
 	//	DirectoryDetails::mimeDetailsList is filled in
 	//	only if scanning of particular directory is complete
+	// Mime details are shared with the store (no copy is made under the lock).
+	// Spilled mime details are read back from disk.
 	bool tryGetDirectory(
 		const QString& unifiedPath,
 		bool fillinMimeSizesOnlyIfReady,
 		DirectoryDetails& directoryDetails);
+	bool tryGetDirectory(
+		TPathId pathId,
+		bool fillinMimeSizesOnlyIfReady,
+		DirectoryDetails& directoryDetails);
+
+	// Own listing of a directory as of the last scan (for incremental rescan).
+	//	Spilled own mime sizes are read from disk, but not brought back to memory.
+	void upsertDirectoryListing(TPathId pathId, DirectoryListing&& listing);
+	bool tryGetDirectoryListing(TPathId pathId, DirectoryListing& listing) const;
+
+	// Own (non-recursive) stats of a directory as of the last scan.
+	// Recursive totals are kept in DirectoryDetails.
+	bool tryGetOwnStats(TPathId pathId, DirectoryStats& ownStats) const;
+
+	typedef std::function<void(const std::vector<TPathId>&)> TInvalidatedCallback;
+
+	// Marks all scanned (Ready or Error) directories as Stale or Pending so that they would be
+	//	scanned again. Directory listings are kept, so unchanged directories are not re-read.
+	//	Directories with changed status are reported via onInvalidated shard by shard, with no lock held.
+	void invalidateScanResults(const TInvalidatedCallback& onInvalidated);
+
+	// Returns the directory and all its descendants reachable through directory listings
+	std::vector<TPathId> getListedSubtree(TPathId pathId) const;
+
+	// Applies a change of a subtree to a Ready directory: stats = stats - removed + added.
+	// Returns false if the directory is not Ready, otherwise fills in dirDetails with the result.
+	bool adjustReadyDirectory(
+		TPathId pathId,
+		const DirectoryStats& removedStats,
+		const TMimeDetailsList& removedMimeSizes,
+		const DirectoryStats& addedStats,
+		const TMimeDetailsList& addedMimeSizes,
+		DirectoryDetails& dirDetails);
+
+	// Marks a Ready directory as Stale. Returns false if the directory is not Ready.
+	bool markStale(TPathId pathId);
+
+	// Marks Ready directories of a listed subtree as Stale, returns the marked ones
+	std::vector<TPathId> markSubtreeStale(TPathId pathId);
+
+	// Forgets a directory (e.g. removed one) together with its subtree.
+	//	Saved ones are written as removed to the next snapshot.
+	void removeDirectorySubtree(TPathId pathId);
 
 	// Returns true if any data (at least for 1 dir) are present
 	bool hasData() const;
 
+	typedef std::vector<
+		std::pair<TPathId, DirectoryDetails>
+	> TDirectoriesSnapshot;
+
+	// Copy of all directories. Shards are copied one at a time, each one under its lock
+	//	(mime details are shared, not copied).
+	// Spilled mime details are read from disk, but not brought back to memory.
+	TDirectoriesSnapshot getSnapshot(bool withMimeDetails = true) const;
+
 	/// <summary>
-	/// Saves current data (m_directories) to database
+	/// Saves a snapshot of scanned (Ready or Stale) directories to database.
+	/// A snapshot is a delta: only directories whose stats differ from the previous
+	///	snapshot are written, removed directories are written as tombstones.
+	/// Mime details are written along with the stats of directories of at least
+	///	the configured size (store/mime_details_min_size_mb).
+	/// The store is not locked while writing.
 	/// </summary>
 	void saveCurrentData();
 
@@ -42,24 +123,292 @@ public:
 		DirectoryStats
 	> TDirectoryStatsHistory;
 
-	/// Retrieves all previously stored directory stats from the store
+	// Approximate memory taken by directory data (allocator overhead is not counted)
+	struct MemoryReport
+	{
+		size_t directoryCount = 0;
+		size_t directoryBytes = 0;			// Packed records, including unused slots
+		size_t unpackedDirectoryBytes = 0;	// Same directories as hash map nodes of DirectoryDetails
+		size_t mimeListCount = 0;
+		size_t mimeListBytes = 0;
+		size_t spilledMimeListCount = 0;
+		size_t spillFileBytes = 0;
+		size_t spillFileFreeBytes = 0;		// Released slots waiting for reuse
+		size_t listingCount = 0;
+		size_t listingBytes = 0;
+		size_t pathBytes = 0;				// PathTable
+	};
+
+	MemoryReport getMemoryReport() const;
+
+	typedef std::function<void(const std::vector<TPathId>&)> TLoadedCallback;
+	typedef std::function<bool()> TCancelledPredicate;
+	typedef std::function<void(int)> TProgressCallback;	// Percentage
+
+	// Returns true if the database was saved by an older version and is to be upgraded
+	bool isUpgradeNeeded() const;
+
+	/// Upgrades the database saved by an older version, which takes a while for a long history.
+	///	Meant to be called at startup on a background thread, otherwise the first database
+	///	access upgrades it. Does nothing if the database is up to date.
+	void upgradeDatabase(const TProgressCallback& onProgress = {}) const;
+
+	/// Loads directory stats of the last saved snapshot (reconstructed from deltas) as Stale directories, then
+	///	their saved mime details (subject to the memory budget). Rows are streamed and put to the store in batches, each batch is
+	///	reported via onLoaded. Directories already present in the store are not touched.
+	/// Returns number of loaded directories.
+	size_t loadLastSnapshot(const TLoadedCallback& onLoaded, const TCancelledPredicate& isCancelled);
+
+	/// Retrieves directory stats for each snapshot since the directory first appeared
+	///	(reconstructed from deltas) until it was removed
 	TDirectoryStatsHistory getDirectoryStatsHistory(const QString& unifiedPath) const;
 
+	typedef std::map<
+		std::chrono::utc_clock::time_point,
+		TMimeDetailsList
+	> TMimeDetailsHistory;
+
+	/// Retrieves saved mime details of the directory for each snapshot. Snapshots where
+	///	the directory was smaller than the threshold (or absent) are missing.
+	TMimeDetailsHistory getDirectoryMimeDetailsHistory(const QString& unifiedPath) const;
+
+	typedef std::map<
+		std::chrono::utc_clock::time_point,
+		MimeDetails
+	> TMimeTypeHistory;
+
+	typedef std::map<
+		QString,			// Mime type
+		TMimeTypeHistory
+	> TMimeTypesHistory;
+
+	/// Retrieves history of the given mime types of the directory, a point per snapshot with saved
+	///	mime details (zero if there were no such files). Only the rows of these mime types are read.
+	TMimeTypesHistory getMimeTypesHistory(const QString& unifiedPath, const std::vector<QString>& mimeTypes) const;
+
+	typedef std::vector<
+		std::pair<
+			long long,		// Snapshot ID
+			std::chrono::utc_clock::time_point>
+	> TSnapshotList;
+
+	// Saved snapshots, the oldest first
+	TSnapshotList getSnapshots() const;
+
+	// Signed change of directory stats between two snapshots
+	struct StatsDelta
+	{
+		long long totalSize = 0;
+		long long totalFileCount = 0;
+		long long subdirectoryCount = 0;
+
+		bool isZero() const noexcept { return 0 == totalSize && 0 == totalFileCount && 0 == subdirectoryCount; }
+
+		StatsDelta& operator+=(const StatsDelta& rhs) noexcept
+		{
+			totalSize += rhs.totalSize;
+			totalFileCount += rhs.totalFileCount;
+			subdirectoryCount += rhs.subdirectoryCount;
+			return *this;
+		}
+
+		StatsDelta& operator-=(const StatsDelta& rhs) noexcept
+		{
+			totalSize -= rhs.totalSize;
+			totalFileCount -= rhs.totalFileCount;
+			subdirectoryCount -= rhs.subdirectoryCount;
+			return *this;
+		}
+	};
+
+	struct DirectoryDiff
+	{
+		QString unifiedPath;
+		unsigned long long sizeFrom = 0;	// 0 if the directory was absent
+		unsigned long long sizeTo = 0;
+		StatsDelta subtreeDelta;			// Change of the recursive totals
+		StatsDelta ownDelta;				// Part of subtreeDelta not explained by changed subdirectories
+	};
+
+	struct SnapshotDiff
+	{
+		size_t changedDirectoryCount = 0;
+		std::vector<DirectoryDiff> growers;		// Largest own size growth first
+		std::vector<DirectoryDiff> shrinkers;	// Largest own size loss first
+	};
+
+	/// Compares two snapshots (reconstructed from deltas) and ranks directories by the change of size
+	///	not explained by their changed subdirectories, so a change deep in a tree is credited once
+	///	rather than to each of its ancestors. Only the delta rows between the snapshots are read if
+	///	there are few of them, otherwise the directories table is scanned once. Memory is bounded by
+	///	the directories with pending subdirectory changes and topCount.
+	SnapshotDiff diffSnapshots(long long fromSnapshotId, long long toSnapshotId, size_t topCount) const;
+
 private:
 	DirectoryStore();
 	DirectoryStore(const DirectoryStore&) = delete;
 	DirectoryStore& operator=(const DirectoryStore&) = delete;
 
-	mutable std::mutex m_sync;
+	struct Shard
+	{
+		mutable std::mutex sync;
+
+		// Index is pathId / STORE_SHARD_COUNT, path IDs are allocated sequentially
+		std::vector<PackedDirectory> directories;
+		size_t directoryCount = 0;
+
+		std::unordered_map<
+			TPathId,	// Interned unified path
+			DirectoryListing
+		> listings;
+
+		std::unordered_map<
+			TPathId,	// Directory with Spilled flag
+			uint64_t	// Offset in the spill file
+		> spillOffsets;
+
+		std::unordered_map<
+			TPathId,	// Directory whose listing has own mime sizes spilled
+			uint64_t	// Offset in the spill file
+		> listingSpillOffsets;
+
+		// Persisted directories removed since the last saved snapshot
+		std::vector<TPathId> removedPersisted;
+
+		PackedDirectory* find(TPathId pathId);
+		const PackedDirectory* find(TPathId pathId) const;
+		PackedDirectory& findOrAdd(TPathId pathId);
+		void erase(TPathId pathId);
+	};
+
+	std::array<Shard, STORE_SHARD_COUNT> m_shards;
+
+	// Serializes database writes, the in-memory data are not locked by it
+	std::mutex m_syncDb;
+
+	typedef std::unordered_map<
+		TPathId,	// Interned unified path (valid within the process only)
+		long long	// ID in the paths table
+	> TDbPathIds;
+
+	// Database IDs of paths which are committed to the paths table
+	mutable std::mutex m_syncDbIds;
+	mutable TDbPathIds m_dbPathIds;
+
+	typedef std::unordered_map<
+		TExtensionId,	// Interned extension (valid within the process only)
+		long long		// ID in the extensions table
+	> TDbExtensionIds;
+
+	// Database IDs of extensions which are committed to the extensions table
+	mutable TDbExtensionIds m_dbExtensionIds;
+
+	// Bytes of mime details kept in memory, beyond it cold ones are spilled (0 for no limit)
+	std::atomic<size_t> m_memoryBudget = 0;
+
+	// Mime details of smaller directories are not saved
+	size_t m_mimeDetailsMinSize = 0;
+
+	// Mime details of directories and own mime sizes of their listings
+	std::atomic<size_t> m_mimeBytes = 0;
+
+	// Protects spilling. The spill file is created on the first spill and then used
+	//	without the lock by those who see a Spilled directory (under the shard lock).
+	//	Slots of the file are read and released under the lock of the directory's shard only.
+	mutable std::mutex m_syncSpill;
+	std::unique_ptr<MimeSpillFile> m_pSpillFile;
+
+	// Shard where the next spill sweep starts
+	size_t m_spillShardIndex = 0;
 
-	std::map<
-		QString,	// Unified path
-		DirectoryDetails
-	> m_directories;
+	Shard& shard(TPathId pathId) { return m_shards[pathId % STORE_SHARD_COUNT]; }
+	const Shard& shard(TPathId pathId) const { return m_shards[pathId % STORE_SHARD_COUNT]; }
+
+	// Locks shards one at a time
+	std::vector<TPathId> collectListedSubtree(TPathId pathId) const;
+
+	struct SavedDirectory
+	{
+		TPathId pathId;
+		DirectoryStats stats;
+
+		// Mime details to save (spilled ones are read back)
+		TMimeDetailsListPtr mimeDetailsList;
+	};
+
+	// Directories changed since the last saved snapshot and removed ones (taken from the shards)
+	void collectUnsavedChanges(
+		std::vector<SavedDirectory>& changed,
+		std::vector<TPathId>& removed);
+
+	// Marks directories Persisted unless their stats or mime details changed in between
+	void markPersisted(const std::vector<SavedDirectory>& saved);
+
+	static size_t readMemoryBudget();
+	static size_t readMimeDetailsMinSize();
+
+	// Shard is locked by the caller. A directory is no longer Persisted if its saved mime details change,
+	//	unless keepPersisted is set for details restored as they were.
+	void assignMimeDetails(
+		Shard& shard_,
+		TPathId pathId,
+		PackedDirectory& packedDir,
+		TMimeDetailsListPtr pMimeDetails,
+		bool keepPersisted = false);
+
+	// Shard is locked by the caller. Compares with the current mime details, spilled ones are read back.
+	bool hasSameMimeDetails(
+		const Shard& shard_,
+		TPathId pathId,
+		const PackedDirectory& packedDir,
+		const TMimeDetailsListPtr& pMimeDetails) const;
+
+	// Shard is locked by the caller
+	void assignListing(Shard& shard_, TPathId pathId, DirectoryListing&& listing);
+	void eraseListing(Shard& shard_, TPathId pathId);
+
+	// Bytes of own mime sizes of a listing counted in the memory budget
+	static size_t listingMimeBytes(const DirectoryListing& listing);
+
+	// Reads mime details from the spill file, returns nullptr if the file cannot be read.
+	//	Shard of the directory is locked by the caller, so that the slot is not released in between.
+	TMimeDetailsListPtr readSpilledMimeDetails(uint64_t spillOffset) const;
+
+	// Shard is locked by the caller. Reads spilled mime details and puts them back to memory.
+	//	Returns nullptr if the file cannot be read.
+	TMimeDetailsListPtr faultInMimeDetails(Shard& shard_, TPathId pathId, PackedDirectory& packedDir);
+
+	// Spills mime details of cold directories until memory is within the budget.
+	//	Own mime sizes of listings (read on rescan only) go first, then mime details of directories
+	//	not read since the previous sweep (second chance) and not held by anyone.
+	void enforceMemoryBudget();
+
+	// Returns ID of the path in the paths table, resolving it component by component.
+	//	Missing components are inserted if addMissing, otherwise 0 is returned.
+	//	Resolved IDs are put to resolved, the caller caches them once they are committed.
+	long long getDbPathId(SqliteDb& db, TPathId pathId, bool addMissing, TDbPathIds& resolved) const;
+
+	void cacheDbPathIds(const TDbPathIds& dbPathIds) const;
+
+	// Returns ID of the extension in the extensions table, inserting it if missing.
+	//	Resolved IDs are put to resolved, the caller caches them once they are committed.
+	long long getDbExtensionId(SqliteDb& db, TExtensionId extensionId, TDbExtensionIds& resolved) const;
+
+	void cacheDbExtensionIds(const TDbExtensionIds& dbExtensionIds) const;
 
 	std::wstring getDbFileName() const;
 
 	void checkCreateDbSchema();
+
+	// Adds columns missing in the existing directories table
+	void upgradeDirectoriesTable(SqliteDb& db);
+
+	// Converts directories table keyed by path text into the one keyed by path ID
+	void migrateDirectoriesToPathIds(SqliteDb& db, const TProgressCallback& onProgress) const;
+
+	// Serializes the upgrade with its check by database accesses
+	mutable std::mutex m_syncUpgrade;
+	mutable bool m_pathIdsMigrationNeeded = false;
 };
 
 #endif // DIRECTORYSTORE_H
@@ -0,0 +1,95 @@
+#include <cassert>
+#include <mutex>
+#include <QFile>
+
+#include "ExtensionTable.h"
+#include "MimeDetails.h"
+
+ExtensionTable::ExtensionTable()
+{
+	TExtensionId allId = intern(TMimeDetailsList::ALL_MIMETYPE);
+	assert(TMimeDetailsList::ALL_MIMETYPE_ID == allId);
+}
+
+ExtensionTable*
+ExtensionTable::instance()
+{
+	static ExtensionTable s_instance;
+	return &s_instance;
+}
+
+TExtensionId
+ExtensionTable::intern(const QString& extension)
+{
+	{
+		std::shared_lock lock_(m_sync);
+
+		auto iter = m_ids.find(extension);
+		if (iter != m_ids.end())
+			return iter->second;
+	}
+
+	std::unique_lock lock_(m_sync);
+
+	// Could be added in between
+	auto iter = m_ids.find(extension);
+	if (iter != m_ids.end())
+		return iter->second;
+
+	TExtensionId id = static_cast<TExtensionId>(m_names.size());
+	m_names.push_back(extension);
+	m_ids.emplace(extension, id);
+
+	return id;
+}
+
+TExtensionId
+ExtensionTable::internLocal8Bit(std::string_view extension)
+{
+	// Per thread cache, since IDs are never released
+	thread_local std::unordered_map<std::string, TExtensionId> s_cache;
+
+	std::string sExtension(extension);
+
+	auto iterCached = s_cache.find(sExtension);
+	if (iterCached != s_cache.end())
+		return iterCached->second;
+
+	TExtensionId id;
+	{
+		std::shared_lock lock_(m_sync);
+
+		auto iter = m_local8BitIds.find(sExtension);
+		if (iter != m_local8BitIds.end())
+			id = iter->second;
+		else
+			id = TExtensionId(-1);
+	}
+
+	if (TExtensionId(-1) == id)
+	{
+		id = intern(QFile::decodeName(QByteArray(extension.data(), static_cast<int>(extension.size()))));
+
+		std::unique_lock lock_(m_sync);
+		m_local8BitIds.emplace(sExtension, id);
+	}
+
+	s_cache.emplace(std::move(sExtension), id);
+	return id;
+}
+
+QString
+ExtensionTable::name(TExtensionId id) const
+{
+	std::shared_lock lock_(m_sync);
+
+	assert(id < m_names.size());
+	return m_names[id];
+}
+
+size_t
+ExtensionTable::size() const
+{
+	std::shared_lock lock_(m_sync);
+	return m_names.size();
+}
@@ -0,0 +1,59 @@
+#ifndef EXTENSIONTABLE_H
+#define EXTENSIONTABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <shared_mutex>
+#include <QString>
+
+// Compact file extension ID
+typedef uint32_t TExtensionId;
+
+// Global dictionary of file extensions (without leading dot).
+// ID 0 is reserved for TMimeDetailsList::ALL_MIMETYPE. IDs are never released.
+class ExtensionTable
+{
+public:
+	static ExtensionTable* instance();
+
+	// Returns ID of the extension, adding it if necessary
+	TExtensionId intern(const QString& extension);
+
+	// Same as intern(QFile::decodeName(extension)), but avoids decoding
+	//	of already known extensions
+	TExtensionId internLocal8Bit(std::string_view extension);
+
+	// Extension by ID
+	QString name(TExtensionId id) const;
+
+	// Number of interned extensions
+	size_t size() const;
+
+private:
+	ExtensionTable();
+	ExtensionTable(const ExtensionTable&) = delete;
+	ExtensionTable& operator=(const ExtensionTable&) = delete;
+
+	mutable std::shared_mutex m_sync;
+
+	// Index is an ID
+	std::deque<QString> m_names;
+
+	struct NameHash
+	{
+		size_t operator()(const QString& name) const noexcept
+		{
+			return qHash(name);
+		}
+	};
+
+	std::unordered_map<QString, TExtensionId, NameHash> m_ids;
+
+	// Local 8-bit encoded extensions already seen
+	std::unordered_map<std::string, TExtensionId> m_local8BitIds;
+};
+
+#endif // EXTENSIONTABLE_H
@@ -79,10 +79,11 @@ HistoryProvider::removeThreadFromThePoolWithLock(const std::thread::id& threadId
 void
 HistoryProvider::getDirectoryHistoryAsync(
     const QString& dirPath,
+    const std::vector<QString>& mimeTypes,
     std::function<void(TDirectoryHistoryPtr)> callbackComplete)
 {
     std::thread th(
-        std::bind(&HistoryProvider::getDirectoryHistoryWorker, this, dirPath, callbackComplete)
+        std::bind(&HistoryProvider::getDirectoryHistoryWorker, this, dirPath, mimeTypes, callbackComplete)
     );
 
     addThreadToThePool(std::move(th));
@@ -91,6 +92,7 @@ HistoryProvider::getDirectoryHistoryAsync(
 void
 HistoryProvider::getDirectoryHistoryWorker(
     const QString& unifiedPath,
+    const std::vector<QString>& mimeTypes,
     std::function<void(TDirectoryHistoryPtr)> callbackComplete)
 {
     KDBG_CURRENT_THREAD_NAME(L"HistoryProvider::getDirectoryHistoryWorker");
@@ -101,7 +103,9 @@ HistoryProvider::getDirectoryHistoryWorker(
 
     try
     {
-        const auto& storeHistory = DirectoryStore::instance()->getDirectoryStatsHistory(unifiedPath);
+        auto pStore = DirectoryStore::instance();
+
+        const auto& storeHistory = pStore->getDirectoryStatsHistory(unifiedPath);
         for (const auto& iter : storeHistory)
         {
             auto utcTimestamp = iter.first;
@@ -110,7 +114,16 @@ HistoryProvider::getDirectoryHistoryWorker(
             QDateTime dt = convertToQDateTime(utcTimestamp);
 
             assert(dirStats.totalSize.has_value());
-            history->emplace(std::make_pair(dt, dirStats.totalSize.value()));
+            history->totalSizes.emplace(std::make_pair(dt, dirStats.totalSize.value()));
+        }
+
+        const auto& mimeTypesHistory = pStore->getMimeTypesHistory(unifiedPath, mimeTypes);
+        for (const auto& mimeTypeIter : mimeTypesHistory)
+        {
+            auto& mimeTypeSizes = history->mimeTypeSizes[mimeTypeIter.first];
+
+            for (const auto& iter : mimeTypeIter.second)
+                mimeTypeSizes.emplace(std::make_pair(convertToQDateTime(iter.first), iter.second.totalSize));
         }
     }
     catch (const std::exception& ex)
@@ -2,6 +2,7 @@
 #define HISTORYPROVIDER_H
 
 #include <map>
+#include <vector>
 #include <unordered_map>
 #include <mutex>
 #include <optional>
@@ -21,13 +22,25 @@ public:
 
 	typedef std::map<
 		QDateTime,				// timestamp
-		unsigned long long		// total directory size
-	> TDirectoryHistory;
+		unsigned long long		// total size
+	> TSizeHistory;
+
+	struct TDirectoryHistory
+	{
+		TSizeHistory totalSizes;		// Of the whole directory
+
+		std::map<
+			QString,					// Mime type
+			TSizeHistory
+		> mimeTypeSizes;
+	};
 
 	typedef std::shared_ptr<TDirectoryHistory> TDirectoryHistoryPtr;
 
+	// Retrieves total size history of the directory and the given mime types in it
 	void getDirectoryHistoryAsync(
 		const QString& unifiedPath,
+		const std::vector<QString>& mimeTypes,
 		std::function<void (TDirectoryHistoryPtr)> callbackComplete);
 
 	// Cancels execution of callbackComplete specified in scanDirectoriesSequentially()
@@ -61,6 +74,7 @@ private:
 
 	void getDirectoryHistoryWorker(
 		const QString& dirPath,
+		const std::vector<QString>& mimeTypes,
 		std::function<void(TDirectoryHistoryPtr)> callbackComplete);
 };
 
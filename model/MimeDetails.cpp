@@ -1,23 +1,32 @@
+#include <algorithm>
 #include "MimeDetails.h"
 
+namespace
+{
+    bool lessId(const TMimeDetailsList::value_type& item, TExtensionId id)
+    {
+        return item.first < id;
+    }
+}
+
 TMimeDetailsList::TMimeDetailsList()
 {
-    addMimeDetails(ALL_MIMETYPE, 0, 0);
+    m_items.emplace_back(ALL_MIMETYPE_ID, MimeDetails{});
 }
 
 void
 TMimeDetailsList::addMimeDetails(
-    QString mimeType,
+    TExtensionId mimeTypeId,
     unsigned long long totalSize,
     unsigned long fileCount)
 {
-    auto iter = find(mimeType);
-    if (iter == end())
+    auto iter = std::lower_bound(m_items.begin(), m_items.end(), mimeTypeId, lessId);
+    if (iter == m_items.end() || iter->first != mimeTypeId)
     {
         MimeDetails md;
         md.totalSize = totalSize;
         md.fileCount = fileCount;
-        emplace(std::make_pair(mimeType, md));
+        m_items.emplace(iter, mimeTypeId, md);
     }
     else
     {
@@ -26,11 +35,102 @@ TMimeDetailsList::addMimeDetails(
     }
 }
 
+void
+TMimeDetailsList::addMimeDetails(
+    const QString& mimeType,
+    unsigned long long totalSize,
+    unsigned long fileCount)
+{
+    addMimeDetails(ExtensionTable::instance()->intern(mimeType), totalSize, fileCount);
+}
+
 void
 TMimeDetailsList::addMimeDetails(const TMimeDetailsList& mimeDetailsList)
 {
-    for (const auto& mt : mimeDetailsList)
+    const auto& otherItems = mimeDetailsList.m_items;
+
+    // Usually a parent already has all mime types of a child, then counters are added in place
+    bool subset = otherItems.size() <= m_items.size();
+    for (auto iter = m_items.cbegin(), iterOther = otherItems.cbegin(); subset && iterOther != otherItems.cend(); ++iterOther)
+    {
+        iter = std::lower_bound(iter, m_items.cend(), iterOther->first, lessId);
+        subset = iter != m_items.cend() && iter->first == iterOther->first;
+    }
+
+    if (subset)
+    {
+        auto iter = m_items.begin();
+        for (const auto& otherItem : otherItems)
+        {
+            iter = std::lower_bound(iter, m_items.end(), otherItem.first, lessId);
+            iter->second.totalSize += otherItem.second.totalSize;
+            iter->second.fileCount += otherItem.second.fileCount;
+        }
+
+        return;
+    }
+
+    // Linear merge
+    TItems merged;
+    merged.reserve(m_items.size() + otherItems.size());
+
+    auto iter = m_items.cbegin();
+    auto iterOther = otherItems.cbegin();
+    while (iter != m_items.cend() || iterOther != otherItems.cend())
+    {
+        if (iterOther == otherItems.cend() ||
+            (iter != m_items.cend() && iter->first < iterOther->first))
+        {
+            merged.push_back(*iter++);
+        }
+        else if (iter == m_items.cend() || iterOther->first < iter->first)
+        {
+            merged.push_back(*iterOther++);
+        }
+        else
+        {
+            MimeDetails md;
+            md.totalSize = iter->second.totalSize + iterOther->second.totalSize;
+            md.fileCount = iter->second.fileCount + iterOther->second.fileCount;
+            merged.emplace_back(iter->first, md);
+
+            ++iter;
+            ++iterOther;
+        }
+    }
+
+    m_items.swap(merged);
+}
+
+void
+TMimeDetailsList::subtractMimeDetails(const TMimeDetailsList& mimeDetailsList)
+{
+    auto iter = m_items.begin();
+    for (const auto& otherItem : mimeDetailsList.m_items)
     {
-        addMimeDetails(mt.first, mt.second.totalSize, mt.second.fileCount);
+        iter = std::lower_bound(iter, m_items.end(), otherItem.first, lessId);
+        if (iter == m_items.end())
+            break;
+
+        if (iter->first != otherItem.first)
+            continue;
+
+        auto& md = iter->second;
+        md.totalSize = md.totalSize > otherItem.second.totalSize ? md.totalSize - otherItem.second.totalSize : 0;
+        md.fileCount = md.fileCount > otherItem.second.fileCount ? md.fileCount - otherItem.second.fileCount : 0;
     }
+
+    m_items.erase(std::remove_if(m_items.begin(), m_items.end(), [](const auto& item) {
+        return 0 == item.second.fileCount && ALL_MIMETYPE_ID != item.first;
+    }), m_items.end());
+}
+
+const MimeDetails*
+TMimeDetailsList::find(TExtensionId mimeTypeId) const
+{
+    auto iter = std::lower_bound(m_items.cbegin(), m_items.cend(), mimeTypeId, lessId);
+    if (iter == m_items.cend() || iter->first != mimeTypeId)
+        return nullptr;
+
+    return &iter->second;
 }
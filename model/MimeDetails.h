@@ -1,30 +1,72 @@
 #ifndef MIMEDETAILS_H
 #define MIMEDETAILS_H
 
-#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <QString>
 
+#include "ExtensionTable.h"
+
 struct MimeDetails
 {
     unsigned long long totalSize = 0;
     unsigned long fileCount = 0;
+
+    bool operator==(const MimeDetails& rhs) const = default;
 };
 
-// MIME is kinb of misused and actually stands for file extension
-struct TMimeDetailsList : std::map<
-    QString,    // Mime type
-    MimeDetails>
+// MIME is kinb of misused and actually stands for file extension.
+// Counters are kept in a flat vector sorted by extension ID (see ExtensionTable),
+//  ALL_MIMETYPE is always the first item.
+struct TMimeDetailsList
 {
+    typedef std::pair<
+        TExtensionId,   // Mime type
+        MimeDetails> value_type;
+    typedef std::vector<value_type> TItems;
+    typedef TItems::const_iterator const_iterator;
+
     inline static const QString ALL_MIMETYPE = "*";
+    static constexpr TExtensionId ALL_MIMETYPE_ID = 0;
 
     TMimeDetailsList();
 
     void addMimeDetails(
-        QString mimeType,
+        TExtensionId mimeTypeId,
+        unsigned long long totalSize,
+        unsigned long fileCount);
+
+    void addMimeDetails(
+        const QString& mimeType,
         unsigned long long totalSize,
         unsigned long fileCount);
 
+    // Merges two sorted lists
     void addMimeDetails(const TMimeDetailsList& mimeDetailsList);
+
+    // Counters are clamped at 0, mime types without files are removed
+    void subtractMimeDetails(const TMimeDetailsList& mimeDetailsList);
+
+    // Returns nullptr if there are no details for the mime type
+    const MimeDetails* find(TExtensionId mimeTypeId) const;
+
+    size_t size() const noexcept { return m_items.size(); }
+    const_iterator begin() const noexcept { return m_items.cbegin(); }
+    const_iterator end() const noexcept { return m_items.cend(); }
+    const_iterator cbegin() const noexcept { return m_items.cbegin(); }
+    const_iterator cend() const noexcept { return m_items.cend(); }
+
+    bool operator==(const TMimeDetailsList& rhs) const { return m_items == rhs.m_items; }
+
+    // Bytes taken by the list including its items
+    size_t memoryUsage() const noexcept { return sizeof(*this) + m_items.capacity() * sizeof(value_type); }
+
+private:
+    TItems m_items;
 };
 
+// Immutable list shared by the data store and its readers
+typedef std::shared_ptr<const TMimeDetailsList> TMimeDetailsListPtr;
+
 #endif // MIMEDETAILS_H
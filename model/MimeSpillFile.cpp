@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+#include "MimeSpillFile.h"
+
+namespace
+{
+	// On-disk item
+	struct SpilledItem
+	{
+		uint64_t totalSize;
+		uint64_t fileCount;
+		TExtensionId mimeTypeId;
+	};
+}
+
+MimeSpillFile::MimeSpillFile(const std::filesystem::path& fileName)
+	: m_fileName(fileName)
+{
+	m_file.open(m_fileName, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("Cannot create spill file " + m_fileName.string());
+}
+
+MimeSpillFile::~MimeSpillFile()
+{
+	m_file.close();
+
+	std::error_code ec;
+	std::filesystem::remove(m_fileName, ec);
+}
+
+uint32_t
+MimeSpillFile::slotCapacity(uint32_t count)
+{
+	// Lists grow and shrink by a few items, so a slot fits lists of similar size
+	return std::bit_ceil(std::max<uint32_t>(count, 1));
+}
+
+uint64_t
+MimeSpillFile::slotSize(uint32_t capacity)
+{
+	return sizeof(uint32_t) + static_cast<uint64_t>(capacity) * sizeof(SpilledItem);
+}
+
+uint64_t
+MimeSpillFile::write(const TMimeDetailsList& mimeDetailsList)
+{
+	std::vector<SpilledItem> items;
+	items.reserve(mimeDetailsList.size());
+
+	for (const auto& item : mimeDetailsList)
+	{
+		items.push_back(SpilledItem{
+			item.second.totalSize,
+			item.second.fileCount,
+			item.first });
+	}
+
+	const uint32_t count = static_cast<uint32_t>(items.size());
+	const uint32_t capacity = slotCapacity(count);
+
+	std::scoped_lock lock_(m_sync);
+
+	// Reuse a released slot of the same size class if any
+	uint64_t offset = m_size;
+	auto& freeOffsets = m_freeOffsets[capacity];
+	const bool reused = !freeOffsets.empty();
+	if (reused)
+		offset = freeOffsets.back();
+
+	m_file.seekp(static_cast<std::streamoff>(offset));
+	m_file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	m_file.write(reinterpret_cast<const char*>(items.data()), count * sizeof(SpilledItem));
+
+	if (!m_file)
+	{
+		m_file.clear();
+		throw std::runtime_error("Cannot write spill file " + m_fileName.string());
+	}
+
+	if (reused)
+	{
+		freeOffsets.pop_back();
+		m_freeSize -= slotSize(capacity);
+	}
+	else
+	{
+		m_size += slotSize(capacity);
+	}
+
+	return offset;
+}
+
+TMimeDetailsList
+MimeSpillFile::read(uint64_t offset)
+{
+	std::vector<SpilledItem> items;
+
+	{
+		std::scoped_lock lock_(m_sync);
+
+		assert(offset < m_size);
+
+		uint32_t count = 0;
+		m_file.seekg(static_cast<std::streamoff>(offset));
+		m_file.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+		if (m_file)
+		{
+			items.resize(count);
+			m_file.read(reinterpret_cast<char*>(items.data()), count * sizeof(SpilledItem));
+		}
+
+		if (!m_file)
+		{
+			m_file.clear();
+			throw std::runtime_error("Cannot read spill file " + m_fileName.string());
+		}
+	}
+
+	// Items are sorted by ID, so each one is appended
+	TMimeDetailsList mimeDetailsList;
+	for (const auto& item : items)
+		mimeDetailsList.addMimeDetails(item.mimeTypeId, item.totalSize, static_cast<unsigned long>(item.fileCount));
+
+	return mimeDetailsList;
+}
+
+void
+MimeSpillFile::release(uint64_t offset)
+{
+	std::scoped_lock lock_(m_sync);
+
+	assert(offset < m_size);
+
+	uint32_t count = 0;
+	m_file.seekg(static_cast<std::streamoff>(offset));
+	m_file.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+	// The slot is just not reused then
+	if (!m_file)
+	{
+		m_file.clear();
+		return;
+	}
+
+	const uint32_t capacity = slotCapacity(count);
+	m_freeOffsets[capacity].push_back(offset);
+	m_freeSize += slotSize(capacity);
+}
+
+uint64_t
+MimeSpillFile::size() const
+{
+	std::scoped_lock lock_(m_sync);
+	return m_size;
+}
+
+uint64_t
+MimeSpillFile::freeSize() const
+{
+	std::scoped_lock lock_(m_sync);
+	return m_freeSize;
+}
@@ -0,0 +1,58 @@
+#ifndef MIMESPILLFILE_H
+#define MIMESPILLFILE_H
+
+#include <cstdint>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "MimeDetails.h"
+
+// File of mime details evicted from memory.
+// Records take slots of a power of 2 items, released slots are reused by lists of the same size class.
+// Extension IDs are valid within the process only, so the file is temporary
+//	and removed when the object is destroyed.
+class MimeSpillFile
+{
+public:
+	// Throws std::runtime_error if the file cannot be created
+	explicit MimeSpillFile(const std::filesystem::path& fileName);
+	~MimeSpillFile();
+
+	// Returns offset of the written list, throws std::runtime_error on failure
+	uint64_t write(const TMimeDetailsList& mimeDetailsList);
+
+	// Throws std::runtime_error on failure
+	TMimeDetailsList read(uint64_t offset);
+
+	// Makes the slot of a written list free for reuse. The list must not be read afterwards.
+	void release(uint64_t offset);
+
+	uint64_t size() const;
+
+	// Bytes of released slots
+	uint64_t freeSize() const;
+
+private:
+	MimeSpillFile(const MimeSpillFile&) = delete;
+	MimeSpillFile& operator=(const MimeSpillFile&) = delete;
+
+	mutable std::mutex m_sync;
+
+	std::filesystem::path m_fileName;
+	std::fstream m_file;
+	uint64_t m_size = 0;
+	uint64_t m_freeSize = 0;
+
+	std::unordered_map<
+		uint32_t,				// Slot capacity (items)
+		std::vector<uint64_t>	// Offsets of released slots
+	> m_freeOffsets;
+
+	static uint32_t slotCapacity(uint32_t count);
+	static uint64_t slotSize(uint32_t capacity);
+};
+
+#endif // MIMESPILLFILE_H
@@ -0,0 +1,91 @@
+#ifndef PACKEDDIRECTORY_H
+#define PACKEDDIRECTORY_H
+
+#include <cstdint>
+
+#include "DirectoryDetails.h"
+
+// Fixed-width form of DirectoryDetails kept by the data store.
+// Optional stats are stored as plain counters with presence bits,
+//	mime details live aside and are shared (only scanned directories have them).
+struct PackedDirectory
+{
+	enum Flags : uint8_t
+	{
+		Present = 0x01,					// Slot holds a directory
+		HasSubdirectoryCount = 0x02,
+		HasTotalFileCount = 0x04,
+		HasTotalSize = 0x08,
+		Scan = 0x10,
+		Referenced = 0x20,				// Mime details were read since the last spill sweep
+		Spilled = 0x40,					// Mime details are in the spill file
+		Persisted = 0x80,				// Stats and mime details are the same as in the last saved snapshot
+	};
+
+	uint64_t totalSize = 0;
+	uint64_t totalFileCount = 0;
+	uint32_t subdirectoryCount = 0;
+	uint8_t status = static_cast<uint8_t>(DirectoryProcessingStatus::Pending);
+	uint8_t flags = 0;
+
+	TMimeDetailsListPtr mimeDetailsList;
+
+	bool isPresent() const noexcept { return 0 != (flags & Present); }
+
+	DirectoryProcessingStatus getStatus() const noexcept { return static_cast<DirectoryProcessingStatus>(status); }
+	void setStatus(DirectoryProcessingStatus value) noexcept { status = static_cast<uint8_t>(value); }
+
+	DirectoryStats stats() const
+	{
+		DirectoryStats retVal;
+
+		if (0 != (flags & HasSubdirectoryCount))
+			retVal.subdirectoryCount = static_cast<unsigned long>(subdirectoryCount);
+		if (0 != (flags & HasTotalFileCount))
+			retVal.totalFileCount = static_cast<unsigned long>(totalFileCount);
+		if (0 != (flags & HasTotalSize))
+			retVal.totalSize = totalSize;
+
+		return retVal;
+	}
+
+	bool hasSameStats(const DirectoryStats& rhs) const
+	{
+		const auto& lhs = stats();
+		return lhs.subdirectoryCount == rhs.subdirectoryCount &&
+			lhs.totalFileCount == rhs.totalFileCount &&
+			lhs.totalSize == rhs.totalSize;
+	}
+
+	void assignStats(const DirectoryStats& rhs)
+	{
+		if (!hasSameStats(rhs))
+			flags &= ~Persisted;
+
+		flags &= ~(HasSubdirectoryCount | HasTotalFileCount | HasTotalSize);
+
+		subdirectoryCount = static_cast<uint32_t>(rhs.subdirectoryCount.value_or(0));
+		totalFileCount = rhs.totalFileCount.value_or(0);
+		totalSize = rhs.totalSize.value_or(0);
+
+		if (rhs.subdirectoryCount.has_value())
+			flags |= HasSubdirectoryCount;
+		if (rhs.totalFileCount.has_value())
+			flags |= HasTotalFileCount;
+		if (rhs.totalSize.has_value())
+			flags |= HasTotalSize;
+	}
+
+	DirectoryDetails unpack(bool withMimeDetails) const
+	{
+		DirectoryDetails retVal{
+			{ stats(), getStatus() },
+			0 != (flags & Scan),
+			withMimeDetails ? mimeDetailsList : TMimeDetailsListPtr{}
+		};
+
+		return retVal;
+	}
+};
+
+#endif // PACKEDDIRECTORY_H
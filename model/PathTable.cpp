@@ -0,0 +1,212 @@
+#include <cassert>
+#include <mutex>
+
+#include "PathTable.h"
+#include "utils.h"
+
+PathTable::PathTable()
+{
+	// Placeholder for InvalidPathId
+	m_nodes.push_back(Node{ InvalidPathId, QString() });
+}
+
+PathTable*
+PathTable::instance()
+{
+	static PathTable s_instance;
+	return &s_instance;
+}
+
+std::vector<QString>
+PathTable::splitPath(const QString& unifiedPath)
+{
+	std::vector<QString> components;
+
+	// Root component includes the slash: "/", "C:/"
+	int pos = unifiedPath.indexOf('/');
+	if (0 > pos)
+	{
+		components.push_back(unifiedPath);
+		return components;
+	}
+
+	components.push_back(unifiedPath.left(pos + 1));
+
+	for (int start = pos + 1; start < unifiedPath.length(); start = pos + 1)
+	{
+		pos = unifiedPath.indexOf('/', start);
+		if (0 > pos)
+			pos = unifiedPath.length();
+
+		if (start < pos)
+			components.push_back(unifiedPath.mid(start, pos - start));
+	}
+
+	return components;
+}
+
+TPathId
+PathTable::findChild(TPathId parentId, const QString& name) const
+{
+	auto iter = m_ids.find(Key{ parentId, name });
+	return iter != m_ids.end() ? iter->second : InvalidPathId;
+}
+
+TPathId
+PathTable::internChild(TPathId parentId, const QString& name)
+{
+	assert(!name.isEmpty());
+
+	{
+		std::shared_lock lock_(m_sync);
+
+		TPathId id = findChild(parentId, name);
+		if (InvalidPathId != id)
+			return id;
+	}
+
+	std::unique_lock lock_(m_sync);
+
+	// Could be added in between
+	TPathId id = findChild(parentId, name);
+	if (InvalidPathId != id)
+		return id;
+
+	assert(m_nodes.size() < UINT32_MAX);
+
+	id = static_cast<TPathId>(m_nodes.size());
+	m_nodes.push_back(Node{ parentId, name, InvalidPathId, m_nodes[parentId].firstChildId });
+	m_nodes[parentId].firstChildId = id;
+	m_ids.emplace(Key{ parentId, name }, id);
+
+	return id;
+}
+
+TPathId
+PathTable::intern(const QString& unifiedPath)
+{
+	if (unifiedPath.isEmpty())
+		return InvalidPathId;
+
+	TPathId id = InvalidPathId;
+	for (const auto& name : splitPath(unifiedPath))
+		id = internChild(id, name);
+
+	return id;
+}
+
+TPathId
+PathTable::find(const QString& unifiedPath) const
+{
+	if (unifiedPath.isEmpty())
+		return InvalidPathId;
+
+	std::shared_lock lock_(m_sync);
+
+	TPathId id = InvalidPathId;
+	for (const auto& name : splitPath(unifiedPath))
+	{
+		id = findChild(id, name);
+		if (InvalidPathId == id)
+			break;
+	}
+
+	return id;
+}
+
+QString
+PathTable::path(TPathId id) const
+{
+	std::shared_lock lock_(m_sync);
+
+	assert(id < m_nodes.size());
+
+	// Names are referenced while the lock is held
+	std::vector<const QString*> names;
+	for (; InvalidPathId != id; id = m_nodes[id].parentId)
+		names.push_back(&m_nodes[id].name);
+
+	// Unified path from the root
+	QString unifiedPath;
+	for (auto iter = names.crbegin(); iter != names.crend(); ++iter)
+		unifiedPath = unifiedPath.isEmpty() ? **iter : getUnifiedChildPath(unifiedPath, **iter);
+
+	return unifiedPath;
+}
+
+QString
+PathTable::name(TPathId id) const
+{
+	std::shared_lock lock_(m_sync);
+
+	assert(id < m_nodes.size());
+	return m_nodes[id].name;
+}
+
+TPathId
+PathTable::parent(TPathId id) const
+{
+	std::shared_lock lock_(m_sync);
+
+	assert(id < m_nodes.size());
+	return m_nodes[id].parentId;
+}
+
+std::vector<TPathId>
+PathTable::children(TPathId id) const
+{
+	std::shared_lock lock_(m_sync);
+
+	assert(id < m_nodes.size());
+
+	std::vector<TPathId> childIds;
+	for (TPathId childId = m_nodes[id].firstChildId; InvalidPathId != childId; childId = m_nodes[childId].nextSiblingId)
+		childIds.push_back(childId);
+
+	return childIds;
+}
+
+bool
+PathTable::isSameOrDescendant(TPathId id, TPathId ancestorId) const
+{
+	if (InvalidPathId == ancestorId)
+		return true;
+
+	std::shared_lock lock_(m_sync);
+
+	for (; InvalidPathId != id; id = m_nodes[id].parentId)
+	{
+		if (id == ancestorId)
+			return true;
+	}
+
+	return false;
+}
+
+size_t
+PathTable::size() const
+{
+	std::shared_lock lock_(m_sync);
+	return m_nodes.size() - 1;
+}
+
+size_t
+PathTable::memoryUsage() const
+{
+	std::shared_lock lock_(m_sync);
+
+	size_t bytes = m_nodes.capacity() * sizeof(Node);
+
+	// Names are implicitly shared between nodes and keys
+	for (const auto& node : m_nodes)
+	{
+		if (!node.name.isNull())
+			bytes += sizeof(QArrayData) + (node.name.capacity() + 1) * sizeof(QChar);
+	}
+
+	// Index node: next pointer, key and ID
+	bytes += m_ids.bucket_count() * sizeof(void*) +
+		m_ids.size() * (sizeof(void*) + sizeof(std::pair<const Key, TPathId>));
+
+	return bytes;
+}
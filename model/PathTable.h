@@ -0,0 +1,103 @@
+#ifndef PATHTABLE_H
+#define PATHTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <QString>
+
+// Compact directory node ID
+typedef uint32_t TPathId;
+
+// Not a valid path (e.g. empty path)
+constexpr TPathId InvalidPathId = 0;
+
+// Interns unified paths as (parent ID, name) pairs, so that each path component
+//	is stored once and paths can be referenced by 32-bit IDs.
+// Roots ("/", "C:/") are nodes without a parent. IDs are never released.
+class PathTable
+{
+public:
+	static PathTable* instance();
+
+	// Returns ID of the unified path, adding missing components
+	TPathId intern(const QString& unifiedPath);
+
+	// Returns ID of a child (name is a single path component) of already interned directory
+	TPathId internChild(TPathId parentId, const QString& name);
+
+	// Returns ID of an already interned unified path or InvalidPathId
+	TPathId find(const QString& unifiedPath) const;
+
+	// Unified path by ID
+	QString path(TPathId id) const;
+
+	// Last path component
+	QString name(TPathId id) const;
+
+	// Parent ID or InvalidPathId for roots
+	TPathId parent(TPathId id) const;
+
+	// Interned children of a directory, roots for InvalidPathId
+	std::vector<TPathId> children(TPathId id) const;
+
+	// Checks if ancestorId is id itself or one of its parents.
+	// InvalidPathId is treated as a common parent of all the roots.
+	bool isSameOrDescendant(TPathId id, TPathId ancestorId) const;
+
+	// Number of interned nodes
+	size_t size() const;
+
+	// Approximate bytes taken by the nodes, names and the lookup index
+	size_t memoryUsage() const;
+
+private:
+	PathTable();
+	PathTable(const PathTable&) = delete;
+	PathTable& operator=(const PathTable&) = delete;
+
+	struct Node
+	{
+		TPathId parentId;
+		QString name;
+
+		// Children are linked in a list, the latest interned first
+		TPathId firstChildId = InvalidPathId;
+		TPathId nextSiblingId = InvalidPathId;
+	};
+
+	struct Key
+	{
+		TPathId parentId;
+		QString name;
+
+		bool operator==(const Key& rhs) const
+		{
+			return parentId == rhs.parentId && name == rhs.name;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const noexcept
+		{
+			return qHash(key.name, key.parentId);
+		}
+	};
+
+	mutable std::shared_mutex m_sync;
+
+	// Index is an ID, the 0th node is a placeholder for InvalidPathId (the parent of roots)
+	std::vector<Node> m_nodes;
+
+	std::unordered_map<Key, TPathId, KeyHash> m_ids;
+
+	// No locking
+	TPathId findChild(TPathId parentId, const QString& name) const;
+
+	// Splits unified path into root and the rest components
+	static std::vector<QString> splitPath(const QString& unifiedPath);
+};
+
+#endif // PATHTABLE_H
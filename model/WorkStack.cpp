@@ -74,8 +74,8 @@ WorkStack::pushScanDirectory(const WorkState& workState)
 
         workState_.assignStats(dirDetails);
 
-        if (dirDetails.mimeDetailsList.has_value())
-            workState_.mimeSizes = dirDetails.mimeDetailsList.value();
+        if (nullptr != dirDetails.mimeDetailsList)
+            workState_.mimeSizes = *dirDetails.mimeDetailsList;
     }
 
     // Update status
@@ -102,7 +102,7 @@ WorkStack::popScanDirectory(DirectoryProcessingStatus status)
     if (DirectoryProcessingStatus::Ready == status)
     {
         dirDetails.DirectoryStats::assignStats(workState);
-        dirDetails.mimeDetailsList = workState.mimeSizes;
+        dirDetails.mimeDetailsList = std::make_shared<const TMimeDetailsList>(workState.mimeSizes);
     }
 
     DirectoryStore::instance()->upsertDirectory(workState.fullPath, dirDetails, true);
@@ -110,12 +110,8 @@ WorkStack::popScanDirectory(DirectoryProcessingStatus status)
     auto pPromise = std::move(top().pPromise);
     checkedPopScanDirectory();
 
-    // In case of successful completion add values (scan results)
-    //  of this directory to the parent directory
-    if (DirectoryProcessingStatus::Ready == status)
-    {
-        copyReadyScanDirectoryDataToParent(workState);
-    }
+    // Results are not added to the parent here: parent totals are computed in a single
+    //  post-order pass when the parent is scanned, reusing the results of this directory
 
     if (pPromise)
         pPromise->set_value(status);
@@ -129,14 +125,6 @@ WorkStack::popReadyScanDirectory()
     // Just remove without changing status
     checkedPopScanDirectory();
 
-    // Also move forward parent's directory iterator
-    if (!m_scanDirectories.empty())
-    {
-        auto& pDirIterator = m_scanDirectories.top().pDirIterator;
-        if (pDirIterator)
-            (*pDirIterator)++;
-    }
-
     if (pPromise)
         pPromise->set_value(DirectoryProcessingStatus::Ready);
 }
@@ -145,14 +133,6 @@ void
 WorkStack::popDisabledScanDirectory()
 {
     popScanDirectory(DirectoryProcessingStatus::Skipped);
-
-    // Also move forward parent's directory iterator
-    if (!m_scanDirectories.empty())
-    {
-        auto& pDirIterator = m_scanDirectories.top().pDirIterator;
-        if (pDirIterator)
-            (*pDirIterator)++;
-    }
 }
 
 void
@@ -167,44 +147,6 @@ WorkStack::popErrorScanDirectory(const QString& workDirPath)
     popScanDirectory(DirectoryProcessingStatus::Error);
 }
 
-void
-WorkStack::copyReadyScanDirectoryDataToParent(const WorkState& workState)
-{
-    const auto& workDirPath = workState.fullPath;
-
-    // In the work stack
-    if (!m_scanDirectories.empty())
-    {
-        auto& parentWorkState = m_scanDirectories.top();
-        parentWorkState.addStats(workState);
-        parentWorkState.mimeSizes.addMimeDetails(workState.mimeSizes);
-
-        // Also move forward the iterator
-        if (parentWorkState.pDirIterator)
-            (*parentWorkState.pDirIterator)++;
-    }
-
-    // Update the data store
-    const auto& parentDirPath = getImmediateParent(workDirPath);
-    if (!parentDirPath.isEmpty() && !m_rootPath.startsWith(parentDirPath))
-    {
-        DirectoryDetails parentDirDetails;
-        bool res = DirectoryStore::instance()->tryGetDirectory(
-            parentDirPath, false, parentDirDetails);
-        if (!res)
-        {
-            parentDirDetails.status = DirectoryProcessingStatus::Pending;
-        }
-
-        if (!parentDirDetails.mimeDetailsList.has_value())
-            parentDirDetails.mimeDetailsList = workState.mimeSizes;
-        else
-            parentDirDetails.mimeDetailsList.value().addMimeDetails(workState.mimeSizes);
-
-        DirectoryStore::instance()->upsertDirectory(parentDirPath, parentDirDetails, true);
-    }
-}
-
 void
 WorkStack::pauseTopDirectory()
 {
@@ -4,7 +4,6 @@
 #include <stack>
 #include <memory>
 #include <future>
-#include <filesystem>
 #include <QString>
 
 #include "model/DirectoryDetails.h"
@@ -15,9 +14,6 @@ struct WorkState : DirectoryStats
 	// Unified path
 	QString	fullPath;
 
-	typedef std::shared_ptr<std::filesystem::directory_iterator> TDirIteratorPtr;
-	TDirIteratorPtr pDirIterator;
-
 	TMimeDetailsList mimeSizes;
 
 	// Promise is optional and can be used by UI thread to wait for completion.
@@ -53,9 +49,6 @@ public:
 	// Removes disabled scan directory from the stack
 	void popDisabledScanDirectory();
 
-	// Cumulatively transfers (adds) results of a finished task to a parrent task
-	void copyReadyScanDirectoryDataToParent(const WorkState& workState);
-
 	// pops a task which caused an error from the work stack
 	void popErrorScanDirectory(const QString& workDirPath);
 
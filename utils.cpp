@@ -4,6 +4,8 @@
 #include <QTimeZone>
 #include "utils.h"
 
+Q_LOGGING_CATEGORY(lcDiagnostics, "getinfo.diagnostics", QtWarningMsg)
+
 QString
 getUnifiedPathName(const QString& path)
 {
@@ -30,10 +32,18 @@ isParentPath(const QString& childUnifiedPath, const QString& parentUnifiedPath)
 	assert(isUnifiedPath(childUnifiedPath));
 	assert(isUnifiedPath(parentUnifiedPath));
 
-	// Avoid "C:/Program Files (x86)" and "C:/Program Files" cases
 	const auto& parentPath = getImmediateParent(childUnifiedPath);
 
-	bool res = parentPath.startsWith(parentUnifiedPath);
+	if (!parentPath.startsWith(parentUnifiedPath))
+		return false;
+
+	// Avoid "C:/Program Files (x86)" and "C:/Program Files" cases
+	const int len = parentUnifiedPath.length();
+	bool res =
+		parentPath.length() == len ||
+		parentUnifiedPath.endsWith('/') ||
+		parentPath[len] == '/';
+
 	return res;
 }
 
@@ -49,9 +59,13 @@ getImmediateParent(const QString unifiedPath)
 	{
 		int pos = unifiedPath.lastIndexOf('/', unifiedPath[len - 1] == '/' ? (len - 2) : -1);
 		if (0 <= pos)
-			parentPath = unifiedPath.left(pos + 1); // Including slash
+		{
+			parentPath = unifiedPath.left(pos);
 
-		parentPath = getUnifiedPathName(parentPath);
+			// Roots keep trailing slash: "/", "C:/"
+			if (parentPath.isEmpty() || parentPath.endsWith(':'))
+				parentPath += '/';
+		}
 	}
 
 	// Make sure that parent path is also in unified format
@@ -60,6 +74,25 @@ getImmediateParent(const QString unifiedPath)
 	return parentPath;
 }
 
+QString
+getUnifiedChildPath(const QString& unifiedParentPath, const QString& name)
+{
+	assert(!name.isEmpty() && !name.contains('/'));
+
+	QString childPath;
+	childPath.reserve(unifiedParentPath.length() + 1 + name.length());
+
+	childPath += unifiedParentPath;
+
+	// Avoid double slash for roots
+	if (!unifiedParentPath.endsWith('/'))
+		childPath += '/';
+
+	childPath += name;
+
+	return childPath;
+}
+
 QDateTime
 convertToQDateTime(std::chrono::utc_clock::time_point dt)
 {
@@ -5,8 +5,13 @@
 #include <chrono>
 #include <QString>
 #include <QDateTime>
+#include <QLoggingCategory>
 #include "config.h"
 
+// Timings and other diagnostics, off by default.
+//	Enabled by QT_LOGGING_RULES="getinfo.diagnostics.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcDiagnostics)
+
 #if K_USE_THREAD_NAMES
 #define KDBG_CURRENT_THREAD_NAME(wsz) { dbgCurrentThreadName(L"* " wsz); }
 #else
@@ -20,11 +25,17 @@ QString getUnifiedPathName(const QString& path);
 bool isUnifiedPath(const QString& path);
 
 // Checks if parentUnifiedPath is one parent firectories for childUnifiedPath
+// N.B. Pure string operation, no file system access
 bool isParentPath(const QString& childUnifiedPath, const QString& parentUnifiedPath);
 
 // Immediate parent directory or null if no parent
+// N.B. Pure string operation, no file system access
 QString getImmediateParent(const QString unifiedPath);
 
+// Unified path of an entry (not a symbolic link) within a unified directory.
+// N.B. Pure string operation, no file system access
+QString getUnifiedChildPath(const QString& unifiedParentPath, const QString& name);
+
 template<class TFunc>
 auto scope_guard(TFunc&& func) {
     return std::unique_ptr<void, typename std::decay<TFunc>::type>{reinterpret_cast<void*>(1), std::forward<TFunc>(func)};
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <algorithm>
 #include "defs.h"
 #include <kdatetimeserieschartview.h>
 #include "kdatetimeserieschartmodel.h"
@@ -22,14 +23,19 @@ KDateTimeSeriesChartModel::setFileSizeDivisor(FileSizeDivisor divisor)
 	emit modelUpdated();
 }
 
+qreal
+KDateTimeSeriesChartModel::applyDivisor(qreal y) const
+{
+	qreal divisorValue = FileSizeDivisorUtils::getDivisorValue(m_divisor);
+	return round(FILE_SIZE_ROUNDING_FACTOR * y / divisorValue) / FILE_SIZE_ROUNDING_FACTOR;
+}
+
 const
 QPointF&
 KDateTimeSeriesChartModel::at(int index) const
 {
-	qreal divisorValue = FileSizeDivisorUtils::getDivisorValue(m_divisor);
-
 	QPointF p = TBase::at(index);
-	p.setY(round(FILE_SIZE_ROUNDING_FACTOR * p.y() / divisorValue) / FILE_SIZE_ROUNDING_FACTOR);
+	p.setY(applyDivisor(p.y()));
 
 	return p;
 }
@@ -38,6 +44,7 @@ void
 KDateTimeSeriesChartModel::beginAppendSeriesDateValues()
 {
 	clear();
+	m_namedSeries.clear();
 }
 
 void
@@ -47,6 +54,47 @@ KDateTimeSeriesChartModel::appendSeriesDateValue(const QDateTime& dateTime, qrea
 	append(msecs, y);
 }
 
+void
+KDateTimeSeriesChartModel::appendSeriesDateValue(const QString& seriesName, const QDateTime& dateTime, qreal y)
+{
+	// Series are shown in order of their first values
+	auto iter = std::find_if(m_namedSeries.begin(), m_namedSeries.end(),
+		[&](const auto& namedSeries) { return namedSeries.first == seriesName; });
+
+	if (iter == m_namedSeries.end())
+		iter = m_namedSeries.emplace(m_namedSeries.end(), seriesName, QVector<QPointF>());
+
+	qint64 msecs = dateTime.toMSecsSinceEpoch();
+	iter->second.append(QPointF(msecs, y));
+}
+
+int
+KDateTimeSeriesChartModel::namedSeriesCount() const
+{
+	return static_cast<int>(m_namedSeries.size());
+}
+
+const QString&
+KDateTimeSeriesChartModel::namedSeriesName(int seriesIndex) const
+{
+	return m_namedSeries.at(seriesIndex).first;
+}
+
+int
+KDateTimeSeriesChartModel::namedSeriesPointCount(int seriesIndex) const
+{
+	return m_namedSeries.at(seriesIndex).second.count();
+}
+
+QPointF
+KDateTimeSeriesChartModel::namedSeriesAt(int seriesIndex, int index) const
+{
+	QPointF p = m_namedSeries.at(seriesIndex).second.at(index);
+	p.setY(applyDivisor(p.y()));
+
+	return p;
+}
+
 void
 KDateTimeSeriesChartModel::endAppendSeriesDateValues()
 {
@@ -1,8 +1,11 @@
 #ifndef KDateTimeSeriesChartModel_H
 #define KDateTimeSeriesChartModel_H
 
+#include <vector>
+#include <utility>
 #include <QLineSeries>
 #include <QDateTime>
+#include <QVector>
 #include "FileSizeDivisor.h"
 
 class KDateTimeSeriesChartView;
@@ -27,12 +30,28 @@ public:
     /// Appends date-time value
     void appendSeriesDateValue(const QDateTime& dateTime, qreal y);
 
+    /// Appends date-time value to a named series (e.g. of a mime type) shown along with the main one
+    void appendSeriesDateValue(const QString& seriesName, const QDateTime& dateTime, qreal y);
+
     /// Recalculates chart ranges so that the all data would be shown properly
     void endAppendSeriesDateValues();
 
+    int namedSeriesCount() const;
+    const QString& namedSeriesName(int seriesIndex) const;
+    int namedSeriesPointCount(int seriesIndex) const;
+    QPointF namedSeriesAt(int seriesIndex, int index) const;
+
 private:
     FileSizeDivisor m_divisor;
 
+    // Values are kept as appended, the divisor is applied when they are read
+    std::vector<std::pair<
+        QString,            // Series name
+        QVector<QPointF>
+    >> m_namedSeries;
+
+    qreal applyDivisor(qreal y) const;
+
     QList<QPointF> points() const = delete;
     QVector<QPointF> pointsVector() const = delete;
 
@@ -60,7 +60,7 @@ KFileSystemModel::data(const QModelIndex& index, int role) const
 
 	if (role == Qt::TextAlignmentRole &&
 		index.isValid() &&
-		1 <= index.column() && index.column() <= 3)
+		1 <= index.column() && index.column() <= 4)
 	{
 		return static_cast<int>(Qt::AlignVCenter | Qt::AlignRight);
 	}
@@ -74,6 +74,16 @@ KFileSystemModel::data(const QModelIndex& index, int role) const
 		return static_cast<int>(enabled ? Qt::Checked : Qt::Unchecked);
 	}
 
+	if (role == Qt::ToolTipRole &&
+		index.isValid() &&
+		index.column() == 2)
+	{
+		auto dirData = lookupDirectoryData(filePath(index));
+		return nullptr != dirData && dirData->ownFileCount.has_value() ?
+			tr("Own files: %L1").arg(static_cast<qulonglong>(dirData->ownFileCount.value())) :
+			QVariant();
+	}
+
 	unsigned int divisorValue = FileSizeDivisorUtils::getDivisorValue(m_divisor);
 
 	if (Qt::DisplayRole == role &&
@@ -101,6 +111,11 @@ KFileSystemModel::data(const QModelIndex& index, int role) const
 					dirData->totalSize.value() / static_cast<float>(divisorValue) * FILE_SIZE_ROUNDING_FACTOR) / FILE_SIZE_ROUNDING_FACTOR) :
 				QString();
 		case 4:
+			return nullptr != dirData && dirData->ownSize.has_value() ?
+				QString("%L1").arg(round(
+					dirData->ownSize.value() / static_cast<float>(divisorValue) * FILE_SIZE_ROUNDING_FACTOR) / FILE_SIZE_ROUNDING_FACTOR) :
+				QString();
+		case 5:
 			return translateDirectoryProcessingStatus(
 				nullptr != dirData ? dirData->status : DirectoryProcessingStatus::Pending);
 		default:
@@ -138,6 +153,9 @@ KFileSystemModel::headerData(int section, Qt::Orientation orientation, int role)
 			returnValue = tr("Total size, ") + FileSizeDivisorUtils::getDivisorSuffix(m_divisor);
 			break;
 		case 4:
+			returnValue = tr("Own size, ") + FileSizeDivisorUtils::getDivisorSuffix(m_divisor);
+			break;
+		case 5:
 			returnValue = tr("Status");
 			break;
 		default:
@@ -235,6 +253,9 @@ KFileSystemModel::translateDirectoryProcessingStatus(DirectoryProcessingStatus s
 	case DirectoryProcessingStatus::Error:
 		sStatus = tr("Error");
 		break;
+	case DirectoryProcessingStatus::Stale:
+		sStatus = tr("Stale");
+		break;
 	default:
 		assert(!"Unexpected value");
 	}
@@ -248,8 +269,13 @@ KFileSystemModel::lookupDirectoryData(const QString& path) const
 	// Translate path to a unified one
 	const QString& fullPath = getUnifiedPathName(path);
 
+	// Directories which have not been scanned are not interned
+	const TPathId pathId = PathTable::instance()->find(fullPath);
+	if (InvalidPathId == pathId)
+		return nullptr;
+
 	// Lookup directory data
-	auto iter = m_dirData.find(fullPath);
+	auto iter = m_dirData.find(pathId);
 
 	// Lookup directory data if they were update before
 	const KDirectoryData* dirData = nullptr;
@@ -265,8 +291,13 @@ KFileSystemModel::lookupDirectoryData(const QString& path)
 	// Translate path to a unified one
 	const QString& fullPath = getUnifiedPathName(path);
 
+	// Directories which have not been scanned are not interned
+	const TPathId pathId = PathTable::instance()->find(fullPath);
+	if (InvalidPathId == pathId)
+		return nullptr;
+
 	// Lookup directory data
-	auto iter = m_dirData.find(fullPath);
+	auto iter = m_dirData.find(pathId);
 
 	// Lookup directory data if they were update before
 	KDirectoryData* dirData = nullptr;
@@ -277,17 +308,12 @@ KFileSystemModel::lookupDirectoryData(const QString& path)
 }
 
 void
-KFileSystemModel::updateDirectoryData(const QString& unifiedPath, KDirectoryData&& dirData)
+KFileSystemModel::updateDirectoryData(TPathId pathId, KDirectoryData&& dirData)
 {
-	assert(isUnifiedPath(unifiedPath));
-
-	auto oldDirData = lookupDirectoryData(unifiedPath);
+	assert(InvalidPathId != pathId);
 
-	// Update directory data
-	if (nullptr != oldDirData)
-		*oldDirData = std::move(dirData);
-	else
-		m_dirData.insert(std::make_pair(unifiedPath, std::move(dirData)));
+	// Update or insert directory data
+	m_dirData.insert_or_assign(pathId, std::move(dirData));
 }
 
 void
@@ -308,6 +334,6 @@ KFileSystemModel::SetDirectoryInfo(const KDirectoryInfo& dirInfo)
 {
 	const auto& unifiedPath = dirInfo.fullPath;
 
-	updateDirectoryData(unifiedPath, static_cast<KDirectoryData>(dirInfo));
+	updateDirectoryData(dirInfo.pathId, static_cast<KDirectoryData>(dirInfo));
 	emitDataChanged(unifiedPath);
 }
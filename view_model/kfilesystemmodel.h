@@ -1,6 +1,7 @@
 #ifndef KFILESYSTEMMODEL_H
 #define KFILESYSTEMMODEL_H
 
+#include <unordered_map>
 #include <QFileSystemModel>
 #include "dir_scanner/KDirectoryInfo.h"
 #include "FileSizeDivisor.h"
@@ -13,7 +14,7 @@ class KFileSystemModel : public QFileSystemModel
 public:
 	KFileSystemModel();
 
-	enum { NumColumns = 5 };
+	enum { NumColumns = 6 };
 
 	void setFileSizeDivisor(FileSizeDivisor divisor);
 
@@ -32,8 +33,8 @@ public:
 private:
 	FileSizeDivisor m_divisor = FileSizeDivisor::Bytes;
 
-	std::map<
-		QString, // N.B. __Unified__ path. Translate to unified path before insertion !
+	std::unordered_map<
+		TPathId, // N.B. Interned __unified__ path. Translate to unified path before interning !
 		KDirectoryData
 	> m_dirData;
 
@@ -43,7 +44,7 @@ private:
 	KDirectoryData* lookupDirectoryData(const QString& path);
 
 	// Updates or inserts directory data
-	void updateDirectoryData(const QString& unifiedPath, KDirectoryData&& dirData);
+	void updateDirectoryData(TPathId pathId, KDirectoryData&& dirData);
 
 	// Emits dataChanged event for the specified path
 	void emitDataChanged(const QString& unifiedPath);
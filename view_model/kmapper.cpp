@@ -1,3 +1,4 @@
+#include <cassert>
 #include <algorithm>
 #include "kmapper.h"
 
@@ -9,12 +10,13 @@ KMapper::mapTMimeDetailsListToKMimeSizesList(
     mimeSizes.reserve(static_cast<int>(mimeDetailsList.size()));
 
     // Map mimeDetailsList to mimeSizes elements
+    auto pExtensionTable = ExtensionTable::instance();
     std::transform(mimeDetailsList.cbegin(), mimeDetailsList.cend(),
-        std::back_inserter(mimeSizes), [](auto iter) {
+        std::back_inserter(mimeSizes), [&](const auto& item) {
             KMimeSize rv;
-            auto& mimeDetails_ = iter.second;
+            auto& mimeDetails_ = item.second;
 
-            rv.mimeType = iter.first;
+            rv.mimeType = pExtensionTable->name(item.first);
             rv.fileCount = mimeDetails_.fileCount;
             rv.totalSize = mimeDetails_.totalSize;
             rv.avgSize = mimeDetails_.fileCount ?
@@ -23,15 +25,9 @@ KMapper::mapTMimeDetailsListToKMimeSizesList(
             return rv;
         });
 
-    // Move TMimeDetailsList::ALL_MIMETYPE to the very beginning
-    for (auto iter = mimeSizes.begin(); iter != mimeSizes.end(); ++iter)
-    {
-        const auto mimeSize = *iter;
-        if (mimeSize.mimeType == TMimeDetailsList::ALL_MIMETYPE)
-        {
-            mimeSizes.erase(iter);
-            mimeSizes.push_front(mimeSize);
-            break;
-        }
-    }
+    // TMimeDetailsList::ALL_MIMETYPE is the very first one, the rest is sorted by name
+    assert(!mimeSizes.isEmpty() && mimeSizes.front().mimeType == TMimeDetailsList::ALL_MIMETYPE);
+    std::sort(mimeSizes.begin() + 1, mimeSizes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.mimeType < rhs.mimeType;
+    });
 }
@@ -105,6 +105,13 @@ KMimeSizesModel::data(const QModelIndex& index, int role) const
     return QVariant();
 }
 
+const QString&
+KMimeSizesModel::mimeType(int row) const
+{
+    assert(row < m_values.count());
+    return m_values[row].mimeType;
+}
+
 void
 KMimeSizesModel::setMimeSizes(KMimeSizesInfo::KMimeSizesList&& values)
 {
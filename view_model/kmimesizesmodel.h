@@ -25,6 +25,9 @@ public:
     // Sets new values by transferring via swap
     void setMimeSizes(KMimeSizesInfo::KMimeSizesList&& values);
 
+    // Mime type shown in the row
+    const QString& mimeType(int row) const;
+
 private:
     FileSizeDivisor m_divisor = FileSizeDivisor::Bytes;
 
@@ -0,0 +1,141 @@
+#include <cmath>
+#include <iterator>
+#include "defs.h"
+#include "ksnapshotdiffmodel.h"
+
+namespace
+{
+    QString
+    formatCountDelta(long long delta)
+    {
+        return (0 < delta ? "+" : "") + QString("%L1").arg(delta);
+    }
+}
+
+void
+KSnapshotDiffModel::setFileSizeDivisor(FileSizeDivisor divisor)
+{
+    bool changed = m_divisor != divisor;
+    m_divisor = divisor;
+
+    if (changed)
+    {
+        emit dataChanged(index(0, 0), index(static_cast<int>(m_values.size()) - 1, NumColumns - 1));
+        emit headerDataChanged(Qt::Horizontal, 0, NumColumns - 1);
+    }
+}
+
+int
+KSnapshotDiffModel::rowCount(const QModelIndex&) const
+{
+    return static_cast<int>(m_values.size());
+}
+
+QVariant
+KSnapshotDiffModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    switch (role) {
+    case Qt::DecorationRole:
+        return QVariant();
+    case Qt::TextAlignmentRole:
+        return Qt::AlignHCenter;
+    }
+
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractItemModel::headerData(section, orientation, role);
+
+    QString returnValue;
+
+    switch (section) {
+    case 0:
+        returnValue = tr("Directory");
+        break;
+    case 1:
+        returnValue = tr("Own size change, ") + FileSizeDivisorUtils::getDivisorSuffix(m_divisor);
+        break;
+    case 2:
+        returnValue = tr("Total size change, ") + FileSizeDivisorUtils::getDivisorSuffix(m_divisor);
+        break;
+    case 3:
+        returnValue = tr("File count change");
+        break;
+    case 4:
+        returnValue = tr("Subdir count change");
+        break;
+    default:
+        assert(!"Unexpected");
+        return QVariant();
+    }
+
+    return returnValue;
+}
+
+QVariant
+KSnapshotDiffModel::data(const QModelIndex& index, int role) const
+{
+    const int colIndex = index.column();
+
+    if (Qt::TextAlignmentRole == role)
+        return 0 == colIndex ? Qt::AlignLeft : Qt::AlignRight;
+
+    if (!index.isValid())
+        return QVariant();
+
+    const int rowIndex = index.row();
+
+    assert(rowIndex < static_cast<int>(m_values.size()));
+    const auto& row = m_values[rowIndex];
+
+    // Sizes of the whole directory in both snapshots
+    if (Qt::ToolTipRole == role)
+    {
+        return QString("%L1 -> %L2")
+            .arg(row.sizeFrom)
+            .arg(row.sizeTo);
+    }
+
+    if (Qt::DisplayRole == role)
+    {
+        switch (colIndex)
+        {
+        case 0:
+            return row.unifiedPath;
+        case 1:
+            return formatSizeDelta(row.ownDelta.totalSize);
+        case 2:
+            return formatSizeDelta(row.subtreeDelta.totalSize);
+        case 3:
+            return formatCountDelta(row.subtreeDelta.totalFileCount);
+        case 4:
+            return formatCountDelta(row.subtreeDelta.subdirectoryCount);
+        default:
+            assert(!"Unexpected");
+            return QVariant();
+        }
+    }
+
+    return QVariant();
+}
+
+QString
+KSnapshotDiffModel::formatSizeDelta(long long delta) const
+{
+    unsigned int divisorValue = FileSizeDivisorUtils::getDivisorValue(m_divisor);
+
+    return (0 < delta ? "+" : "") + QString("%L1").arg(round(
+        delta / static_cast<float>(divisorValue) * FILE_SIZE_ROUNDING_FACTOR) / FILE_SIZE_ROUNDING_FACTOR);
+}
+
+void
+KSnapshotDiffModel::setSnapshotDiff(DirectoryStore::SnapshotDiff&& diff)
+{
+    beginResetModel();
+
+    m_values.swap(diff.growers);
+    m_values.insert(
+        m_values.end(),
+        std::make_move_iterator(diff.shrinkers.begin()),
+        std::make_move_iterator(diff.shrinkers.end()));
+
+    endResetModel();
+}
@@ -0,0 +1,37 @@
+#ifndef KSNAPSHOTDIFFMODEL_H
+#define KSNAPSHOTDIFFMODEL_H
+
+#include <vector>
+#include <QAbstractListModel>
+#include "model/DirectoryStore.h"
+#include "FileSizeDivisor.h"
+
+// Model for a table of directories grown and shrunk the most between two snapshots
+class KSnapshotDiffModel : public QAbstractListModel
+{
+public:
+    enum { NumColumns = 5 };
+
+    void setFileSizeDivisor(FileSizeDivisor divisor);
+
+    int rowCount(const QModelIndex&) const override;
+    int columnCount(const QModelIndex& parent) const override
+    {
+        return NumColumns;
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+
+    // Growers are shown first, then shrinkers
+    void setSnapshotDiff(DirectoryStore::SnapshotDiff&& diff);
+
+private:
+    FileSizeDivisor m_divisor = FileSizeDivisor::Bytes;
+
+    std::vector<DirectoryStore::DirectoryDiff> m_values;
+
+    QString formatSizeDelta(long long delta) const;
+};
+
+#endif // !KSNAPSHOTDIFFMODEL_H